@@ -41,6 +41,8 @@ const struct ethtool_ops ax88179_ethtool_ops = {
 	.get_strings	= ax_get_strings,
 	.get_sset_count = ax_get_sset_count,
 	.get_ethtool_stats = ax_get_ethtool_stats,
+	.get_ringparam	= ax_get_ringparam,
+	.set_ringparam	= ax_set_ringparam,
 	.get_regs_len	= ax_get_regs_len,
 	.get_regs	= ax_get_regs,
 };
@@ -374,16 +376,11 @@ void ax88179_set_multicast(struct net_device *net)
 				1 << (crc_bits & 7);
 		}
 #endif
-		ax_write_cmd_async(axdev, AX_ACCESS_MAC,
-					AX_MULTI_FILTER_ARRY,
-					AX_MCAST_FILTER_SIZE,
-					AX_MCAST_FILTER_SIZE, m_filter);
-
 		axdev->rxctl |= AX_RX_CTL_AM;
 	}
 
-	ax_write_cmd_async(axdev, AX_ACCESS_MAC, AX_RX_CTL,
-				2, 2, &axdev->rxctl);
+	ax_set_rx_mode_async(axdev, axdev->rxctl,
+			     (axdev->rxctl & AX_RX_CTL_AM) ? m_filter : NULL);
 }
 
 int ax88179_set_mac_addr(struct net_device *netdev, void *p)
@@ -1084,11 +1081,7 @@ static void ax88179_rx_fixup(struct ax_device *axdev, struct rx_desc *desc,
 			goto find_next_rx;
 		}
 
-#ifdef ENABLE_RX_TASKLET
-		skb = netdev_alloc_skb(netdev, pkt_len);
-#else
 		skb = napi_alloc_skb(&axdev->napi, pkt_len);
-#endif
 		if (!skb) {
 			stats->rx_dropped++;
 			goto find_next_rx;
@@ -1100,13 +1093,12 @@ static void ax88179_rx_fixup(struct ax_device *axdev, struct rx_desc *desc,
 		ax88179_rx_checksum(skb, &pkt_hdr);
 
 		skb->protocol = eth_type_trans(skb, netdev);
+#if KERNEL_VERSION(3, 11, 0) <= LINUX_VERSION_CODE
+		skb_mark_napi_id(skb, &axdev->napi);
+#endif
 
 		if (*work_done < budget) {
-#ifdef ENABLE_RX_TASKLET
-			netif_receive_skb(skb);
-#else
 			napi_gro_receive(&axdev->napi, skb);
-#endif
 			*work_done += 1;
 			stats->rx_packets++;
 			stats->rx_bytes += pkt_len;
@@ -250,6 +250,15 @@ static int ax88179a_set_wol_get_ts_info
 	struct ax_device *axdev = (struct ax_device *)netdev_priv(dev);
 	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
 
+	/*
+	 * Virtual clocks created through the PHC's n_vclocks attribute are
+	 * looked up from phc_index, and sockets bound to one of them get
+	 * these hardware timestamps converted by the core, so the index
+	 * must only be reported when this device really has a PHC.
+	 */
+	if (!ptp_cfg || !ptp_cfg->ptp_clock)
+		return ethtool_op_get_ts_info(dev, info);
+
 	info->so_timestamping =
 			SOF_TIMESTAMPING_TX_SOFTWARE |
 			SOF_TIMESTAMPING_RX_SOFTWARE |
@@ -260,10 +269,12 @@ static int ax88179a_set_wol_get_ts_info
 
 	info->phc_index = ptp_cfg->phc_index;
 
+	/*
+	 * Only two-step is implemented: TX timestamps are read back over
+	 * EP0/EP4 and the stack sends the Follow_Up.
+	 */
 	info->tx_types = BIT(HWTSTAMP_TX_OFF) |
-			 BIT(HWTSTAMP_TX_ON) |
-			 BIT(HWTSTAMP_TX_ONESTEP_SYNC) |
-			 BIT(HWTSTAMP_TX_ONESTEP_P2P);
+			 BIT(HWTSTAMP_TX_ON);
 
 	info->rx_filters = BIT(HWTSTAMP_FILTER_NONE) |
 			   BIT(HWTSTAMP_FILTER_PTP_V1_L4_EVENT) |
@@ -274,7 +285,10 @@ static int ax88179a_set_wol_get_ts_info
 			   BIT(HWTSTAMP_FILTER_PTP_V2_L4_DELAY_REQ) |
 			   BIT(HWTSTAMP_FILTER_PTP_V2_L2_EVENT) |
 			   BIT(HWTSTAMP_FILTER_PTP_V2_L2_SYNC) |
-			   BIT(HWTSTAMP_FILTER_PTP_V2_L2_DELAY_REQ);
+			   BIT(HWTSTAMP_FILTER_PTP_V2_L2_DELAY_REQ) |
+			   BIT(HWTSTAMP_FILTER_PTP_V2_EVENT) |
+			   BIT(HWTSTAMP_FILTER_PTP_V2_SYNC) |
+			   BIT(HWTSTAMP_FILTER_PTP_V2_DELAY_REQ);
 
 	return 0;
 }
@@ -306,6 +320,8 @@ const struct ethtool_ops ax88179a_ethtool_ops = {
 	.get_strings	= ax_get_strings,
 	.get_sset_count = ax_get_sset_count,
 	.get_ethtool_stats = ax_get_ethtool_stats,
+	.get_ringparam	= ax_get_ringparam,
+	.set_ringparam	= ax_set_ringparam,
 	.get_pauseparam = ax_get_pauseparam,
 	.set_pauseparam = ax_set_pauseparam,
 	.get_regs_len	= ax_get_regs_len,
@@ -340,6 +356,8 @@ const struct ethtool_ops ax88279_ethtool_ops = {
 	.get_strings	= ax_get_strings,
 	.get_sset_count = ax_get_sset_count,
 	.get_ethtool_stats = ax_get_ethtool_stats,
+	.get_ringparam	= ax_get_ringparam,
+	.set_ringparam	= ax_set_ringparam,
 	.get_pauseparam = ax_get_pauseparam,
 	.set_pauseparam = ax_set_pauseparam,
 	.get_regs_len	= ax_get_regs_len,
@@ -818,6 +836,24 @@ int ax88179a_autosuspend_en(struct ax_device *axdev,
 	return 0;
 }
 
+int ax88179a_ptp_delay_cal(struct ax_device *axdev,
+			   struct _ax_ioctl_command *info)
+{
+#ifdef ENABLE_PTP_FUNC
+	int ret;
+
+	DEBUG_PRINTK("%s - Start", __func__);
+
+	ret = ax_ptp_delay_calibrate(axdev, &info->ptp_cal.tx_delay,
+				     &info->ptp_cal.rx_delay);
+	info->ptp_cal.status = ret;
+
+	return ret;
+#else
+	return -EOPNOTSUPP;
+#endif
+}
+
 IOCTRL_TABLE ax88179a_tbl[] = {
 	ax88179a_signature,
 	ax_usb_command,
@@ -832,13 +868,29 @@ IOCTRL_TABLE ax88179a_tbl[] = {
 	ax88179a_ieee_test,
 	ax88179a_autosuspend_en,
 	ax88179a_erase_sector_flash,
+	ax88179a_ptp_delay_cal,
 };
 
 #ifdef ENABLE_PTP_FUNC
 static int ax88179a_hwtstamp_ioctl
 (struct net_device *dev, struct ifreq *ifr, int cmd)
 {
+	struct ax_device *axdev = netdev_priv(dev);
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
 	struct hwtstamp_config config;
+	int ret;
+
+	if (!ptp_cfg || !ptp_cfg->ptp_clock)
+		return -EOPNOTSUPP;
+
+#ifdef SIOCGHWTSTAMP
+	if (cmd == SIOCGHWTSTAMP) {
+		memset(&config, 0, sizeof(config));
+		config.tx_type = ptp_cfg->tx_type;
+		config.rx_filter = ptp_cfg->rx_filter;
+		goto out;
+	}
+#endif
 
 	if (copy_from_user(&config, ifr->ifr_data, sizeof(config)))
 		return -EFAULT;
@@ -846,28 +898,21 @@ static int ax88179a_hwtstamp_ioctl
 	if (config.flags)
 		return -EINVAL;
 
-	switch (config.rx_filter) {
-	case HWTSTAMP_FILTER_NONE:
-		break;
-	case HWTSTAMP_FILTER_PTP_V1_L4_EVENT:
-	case HWTSTAMP_FILTER_PTP_V2_L4_EVENT:
-	case HWTSTAMP_FILTER_PTP_V2_L2_EVENT:
-	case HWTSTAMP_FILTER_ALL:
-	case HWTSTAMP_FILTER_PTP_V1_L4_SYNC:
-	case HWTSTAMP_FILTER_PTP_V1_L4_DELAY_REQ:
-	case HWTSTAMP_FILTER_PTP_V2_L2_SYNC:
-	case HWTSTAMP_FILTER_PTP_V2_L4_SYNC:
-	case HWTSTAMP_FILTER_PTP_V2_L2_DELAY_REQ:
-	case HWTSTAMP_FILTER_PTP_V2_L4_DELAY_REQ:
-	case HWTSTAMP_FILTER_PTP_V2_EVENT:
-	case HWTSTAMP_FILTER_PTP_V2_SYNC:
-	case HWTSTAMP_FILTER_PTP_V2_DELAY_REQ:
-		config.rx_filter = HWTSTAMP_FILTER_ALL;
+	switch (config.tx_type) {
+	case HWTSTAMP_TX_OFF:
+	case HWTSTAMP_TX_ON:
 		break;
 	default:
 		return -ERANGE;
 	}
 
+	ret = ax_ptp_set_rx_filter(axdev, config.rx_filter);
+	if (ret < 0)
+		return ret;
+	config.rx_filter = ret;
+	ptp_cfg->tx_type = config.tx_type;
+	ax_ptp_pm_update(axdev);
+out:
 	return copy_to_user(ifr->ifr_data, &config, sizeof(config)) ?
 		-EFAULT : 0;
 }
@@ -915,6 +960,9 @@ int ax88179a_ioctl(struct net_device *netdev, struct ifreq *rq, int cmd)
 	switch (cmd) {
 #ifdef ENABLE_PTP_FUNC
 	case SIOCSHWTSTAMP:
+#ifdef SIOCGHWTSTAMP
+	case SIOCGHWTSTAMP:
+#endif
 		return ax88179a_hwtstamp_ioctl(netdev, rq, cmd);
 #endif
 	}
@@ -951,6 +999,9 @@ int ax88179a_ioctl(struct net_device *netdev, struct ifreq *rq, int cmd)
 		break;
 #ifdef ENABLE_PTP_FUNC
 	case SIOCSHWTSTAMP:
+#ifdef SIOCGHWTSTAMP
+	case SIOCGHWTSTAMP:
+#endif
 		return ax88179a_hwtstamp_ioctl(netdev, rq, cmd);
 #endif
 	default:
@@ -1005,16 +1056,6 @@ static int ax88179a_bind(struct ax_device *axdev)
 	u16 wvalue = 0;
 	int ret;
 
-	ax88179a_get_fw_version(axdev);
-#ifdef ENABLE_AX88279
-	if (axdev->chip_version == AX_VERSION_AX88279)
-		PRINT_VERSION(axdev, AX_DRIVER_STRING_279);
-	else
-		PRINT_VERSION(axdev, AX_DRIVER_STRING_179A_772D);
-#else
-	PRINT_VERSION(axdev, AX_DRIVER_STRING_179A_772D);
-#endif
-
 #ifdef ENABLE_QUEUE_PRIORITY
 	wvalue |= AX_USB_EP5_EN;
 #endif
@@ -1035,7 +1076,8 @@ static int ax88179a_bind(struct ax_device *axdev)
 			       NETIF_F_SG | NETIF_F_TSO | NETIF_F_FRAGLIST |
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0)
 					NETIF_F_HW_VLAN_CTAG_RX |
-					NETIF_F_HW_VLAN_CTAG_TX;
+					NETIF_F_HW_VLAN_CTAG_TX |
+					NETIF_F_HW_VLAN_CTAG_FILTER;
 #else
 					NETIF_F_HW_VLAN_RX |
 					NETIF_F_HW_VLAN_TX;
@@ -1044,7 +1086,8 @@ static int ax88179a_bind(struct ax_device *axdev)
 			       NETIF_F_SG | NETIF_F_TSO | NETIF_F_FRAGLIST |
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0)
 					NETIF_F_HW_VLAN_CTAG_RX |
-					NETIF_F_HW_VLAN_CTAG_TX | NETIF_F_RXALL;
+					NETIF_F_HW_VLAN_CTAG_TX | NETIF_F_RXALL |
+					NETIF_F_HW_VLAN_CTAG_FILTER;
 #else
 					NETIF_F_HW_VLAN_RX |
 					NETIF_F_HW_VLAN_TX | NETIF_F_RXALL;
@@ -1108,6 +1151,20 @@ static int ax88179a_bind(struct ax_device *axdev)
 	return ret;
 }
 
+/* Only informational, read after the netdev and PHC are registered */
+static void ax88179a_late_init(struct ax_device *axdev)
+{
+	ax88179a_get_fw_version(axdev);
+#ifdef ENABLE_AX88279
+	if (axdev->chip_version == AX_VERSION_AX88279)
+		PRINT_VERSION(axdev, AX_DRIVER_STRING_279);
+	else
+		PRINT_VERSION(axdev, AX_DRIVER_STRING_179A_772D);
+#else
+	PRINT_VERSION(axdev, AX_DRIVER_STRING_179A_772D);
+#endif
+}
+
 static void ax88179a_unbind(struct ax_device *axdev)
 {
 #ifdef ENABLE_PTP_FUNC
@@ -1185,19 +1242,122 @@ void ax88179a_set_multicast(struct net_device *netdev)
 			*(m_filter + (crc_bits >> 3)) |= 1 << (crc_bits & 7);
 		}
 #endif
-		ax_write_cmd_async(axdev, AX_ACCESS_MAC, AX_MULTI_FILTER_ARRY,
-				   AX_MCAST_FILTER_SIZE, AX_MCAST_FILTER_SIZE,
-				   m_filter);
-
 		axdev->rxctl |= AX_RX_CTL_AM;
 	}
 
-	ax_write_cmd_async(axdev, AX_ACCESS_MAC, AX_RX_CTL,
-			   2, 2, &axdev->rxctl);
+	ax_set_rx_mode_async(axdev, axdev->rxctl,
+			     (axdev->rxctl & AX_RX_CTL_AM) ? m_filter : NULL);
+}
+
+#if KERNEL_VERSION(3, 10, 0) <= LINUX_VERSION_CODE
+static u8 ax88179a_vlan_ctrl(netdev_features_t features)
+{
+	u8 reg8 = 0;
+
+	if (features & NETIF_F_HW_VLAN_CTAG_FILTER)
+		reg8 |= AX_VLAN_CONTROL_VFE;
+	if (features & NETIF_F_HW_VLAN_CTAG_RX)
+		reg8 |= AX_VLAN_CONTROL_VSO;
+
+	return reg8;
+}
+
+int ax88179a_set_vlan_ctrl(struct ax_device *axdev, netdev_features_t features)
+{
+	u8 reg8 = ax88179a_vlan_ctrl(features);
+
+	return ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_VLAN_ID_CONTROL,
+			    1, 1, &reg8);
+}
+
+/* Each filter table word holds the enable bits of 16 VIDs */
+static int ax88179a_vlan_write(struct ax_device *axdev, u16 vid)
+{
+	struct ax_cmd_batch *batch;
+	u8 index = vid / 16, reg8;
+	u16 map = 0;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		if (test_bit(index * 16 + i, axdev->active_vlans))
+			map |= BIT(i);
+
+	batch = ax_cmd_batch_init(axdev, 0);
+
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_VLAN_ID_ADDRESS,
+			 1, 1, &index);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_VLAN_ID_DATA0,
+			 2, 2, &map);
+	reg8 = ax88179a_vlan_ctrl(axdev->netdev->features) |
+	       AX_VLAN_CONTROL_WE;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_VLAN_ID_CONTROL,
+			 1, 1, &reg8);
+
+	return ax_cmd_batch_run(batch);
+}
+
+static int ax88179a_vlan_restore(struct ax_device *axdev)
+{
+	unsigned int vid;
+	int ret;
+
+	for (vid = 0; vid < VLAN_N_VID; vid += 16) {
+		if (find_next_bit(axdev->active_vlans, vid + 16, vid) >= vid + 16)
+			continue;
+
+		ret = ax88179a_vlan_write(axdev, vid);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int ax88179a_vlan_update(struct ax_device *axdev, u16 vid)
+{
+	int ret;
+
+	ret = usb_autopm_get_interface(axdev->intf);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&axdev->control);
+	ret = ax88179a_vlan_write(axdev, vid);
+	mutex_unlock(&axdev->control);
+
+	usb_autopm_put_interface(axdev->intf);
+
+	return ret;
+}
+
+int ax88179a_vlan_rx_add_vid(struct net_device *netdev, __be16 proto, u16 vid)
+{
+	struct ax_device *axdev = netdev_priv(netdev);
+
+	set_bit(vid, axdev->active_vlans);
+
+	/* hw_init loads the whole table on ifup */
+	if (!netif_running(netdev))
+		return 0;
+
+	return ax88179a_vlan_update(axdev, vid);
 }
 
+int ax88179a_vlan_rx_kill_vid(struct net_device *netdev, __be16 proto,
+			      u16 vid)
+{
+	struct ax_device *axdev = netdev_priv(netdev);
+
+	clear_bit(vid, axdev->active_vlans);
+
+	/* Restore skips empty words, so clear the entry even while down */
+	return ax88179a_vlan_update(axdev, vid);
+}
+#endif
+
 static int ax88179a_hw_init(struct ax_device *axdev)
 {
+	struct ax_cmd_batch *batch;
 	u16 reg16;
 	u8 reg8;
 	int ret;
@@ -1255,40 +1415,30 @@ static int ax88179a_hw_init(struct ax_device *axdev)
 	if (ret < 0)
 		return ret;
 
+	batch = ax_cmd_batch_init(axdev, 0);
+
 	reg8 = AX_TXCOE_IP | AX_TXCOE_TCP | AX_TXCOE_UDP |
 	       AX_TXCOE_TCPV6 | AX_TXCOE_UDPV6;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &reg8);
 
 	reg8 = AX_RXCOE_IP | AX_RXCOE_TCP | AX_RXCOE_UDP |
 	       AX_RXCOE_TCPV6 | AX_RXCOE_UDPV6;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &reg8);
 
 	reg8 = AX_MAC_EFF_EN;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_MAC_BULK_OUT_CTRL,
-			    1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_BULK_OUT_CTRL,
+			 1, 1, &reg8);
 
 	reg16 = 0;
-	ret = ax_write_cmd_async(axdev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
 
 	reg8 = 0x04;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_LOW,
-			   1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_LOW,
+			 1, 1, &reg8);
 
 	reg8 = 0x10;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
-			   1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
+			 1, 1, &reg8);
 
 	reg8 = 0;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0)
@@ -1303,56 +1453,47 @@ static int ax88179a_hw_init(struct ax_device *axdev)
 		if (axdev->netdev->features & NETIF_F_HW_VLAN_RX)
 #endif		
 	reg8 |= AX_VLAN_CONTROL_VSO;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_VLAN_ID_CONTROL,
-			   1, 1, &reg8);
-	if (ret < 0)
-		return ret;
-
-	reg8 = 0xff;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_MAC_BM_INT_MASK,
-			    1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_VLAN_ID_CONTROL,
+			 1, 1, &reg8);
 
-	reg8 = 0;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_MAC_BM_RX_DMA_CTL,
-			    1, 1, &reg8);
+	ret = ax_cmd_batch_run(batch);
 	if (ret < 0)
 		return ret;
 
-
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_MAC_BM_TX_DMA_CTL,
-			    1, 1, &reg8);
-	if (ret < 0)
-		return ret;
-
-
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_MAC_ARC_CTRL,
-			    1, 1, &reg8);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 10, 0)
+	ret = ax88179a_vlan_restore(axdev);
 	if (ret < 0)
 		return ret;
+#endif
 
+	batch = ax_cmd_batch_init(axdev, 0);
 
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_MAC_SWP_CTRL,
-			    1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	reg8 = 0xff;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_BM_INT_MASK,
+			 1, 1, &reg8);
 
+	reg8 = 0;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_BM_RX_DMA_CTL,
+			 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_BM_TX_DMA_CTL,
+			 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_ARC_CTRL,
+			 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_SWP_CTRL,
+			 1, 1, &reg8);
 
 	reg8 = AX_TXHDR_CKSUM_EN;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_TX_HDR_CKSUM,
-				1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_TX_HDR_CKSUM,
+			 1, 1, &reg8);
 
 	reg16 = AX_RX_CTL_START | AX_RX_CTL_AP | AX_RX_CTL_AMALL |
 		AX_RX_CTL_AB | AX_RX_CTL_DROPCRCERR;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_RX_CTL, 1, 1, &reg16);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL, 1, 1, &reg16);
 
 	reg8 = 0;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, &reg8);
+
+	ret = ax_cmd_batch_run(batch);
 	if (ret < 0)
 		return ret;
 
@@ -1366,20 +1507,13 @@ static int ax88179a_hw_init(struct ax_device *axdev)
 		return ret;
 
 
-	ret = ax_read_cmd(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				 2, 2, &reg16, 2);
-	if (ret < 0)
-		return ret;
-
-	reg16 &= ~AX_MEDIUM_GIGAMODE;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			    2, 2, &reg16);
+	ret = ax_update_reg(axdev, AX_MEDIUM_STATUS_MODE, 2,
+			    AX_MEDIUM_GIGAMODE, 0);
 	if (ret < 0)
 		return ret;
 
-	reg16 |= AX_MEDIUM_GIGAMODE;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			    2, 2, &reg16);
+	ret = ax_update_reg(axdev, AX_MEDIUM_STATUS_MODE, 2,
+			    0, AX_MEDIUM_GIGAMODE);
 	if (ret < 0)
 		return ret;
 
@@ -1505,41 +1639,35 @@ static int ax88179a_set_bulkin_setting(struct ax_device *axdev)
 static int ax88179a_link_setting(struct ax_device *axdev)
 {
 	struct ax_link_info *link_info = &axdev->link_info;
+	struct ax_cmd_batch *batch;
 	u16 medium_mode, reg16;
 	u8 reg8[3];
 	int ret;
 
+	batch = ax_cmd_batch_init(axdev, 1);
+
 	reg16 = AX_RX_CTL_STOP;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
 
 	reg8[0] = 0;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_PATH,
-				1, 1, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, reg8);
 
 	reg8[0] = 0xA5;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_CDC_DELAY_TX,
-				 1, 1, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_CDC_DELAY_TX,
+			 1, 1, reg8);
 
 	reg8[0] = 0x10;
 	reg8[1] = 0x04;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
-				2, 2, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
+			 2, 2, reg8);
 
 	medium_mode = AX_MEDIUM_RECEIVE_EN | AX_MEDIUM_RXFLOW_CTRLEN |
 		      AX_MEDIUM_TXFLOW_CTRLEN;
+	if (axdev->netdev->mtu > 1500)
+		medium_mode |= AX_MEDIUM_JUMBO_EN;
 	reg8[0] = 0x28 | AX_NEW_PAUSE_EN;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_NEW_PAUSE_CTRL,
-			   1, 1, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_NEW_PAUSE_CTRL,
+			 1, 1, reg8);
 
 	switch (link_info->eth_speed) {
 	case ETHER_LINK_1000:
@@ -1547,17 +1675,12 @@ static int ax88179a_link_setting(struct ax_device *axdev)
 		reg8[0] = 0x78;
 		reg8[1] = (AX_LSOFC_WCNT_7_ACCESS << 5) | AX_GMII_CRC_APPEND;
 		reg8[2] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
 
 		reg8[0] = 0x40;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_DATA_CDC_CNT,
-					1, 1, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_DATA_CDC_CNT, 1, 1, reg8);
 		if (link_info->eth_speed == ETHER_LINK_1000)
 			medium_mode |= AX_MEDIUM_GIGAMODE;
 		break;
@@ -1565,25 +1688,21 @@ static int ax88179a_link_setting(struct ax_device *axdev)
 		reg8[0] = 0xFA;
 		reg8[1] = (AX_LSOFC_WCNT_7_ACCESS << 5) | AX_GMII_CRC_APPEND;
 		reg8[2] = 0xFF;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
 
 		reg8[0] = 0xFA;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_DATA_CDC_CNT,
-					1, 1, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_DATA_CDC_CNT, 1, 1, reg8);
 		break;
 	default:
 		break;
 	};
 
 	reg8[0] = 0;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_BFM_DATA,
-				1, 1, reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_BFM_DATA, 1, 1, reg8);
+
+	ret = ax_cmd_batch_run(batch);
 	if (ret < 0)
 		return ret;
 
@@ -1591,26 +1710,21 @@ static int ax88179a_link_setting(struct ax_device *axdev)
 	if (ret < 0)
 		return ret;
 
+	batch = ax_cmd_batch_init(axdev, 1);
+
 	if (link_info->full_duplex)
 		medium_mode |= AX_MEDIUM_FULL_DUPLEX;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				2, 2, &medium_mode);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
+			 2, 2, &medium_mode);
 
 	axdev->rxctl |= AX_RX_CTL_START | AX_RX_CTL_AB;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_RX_CTL,
-				2, 2, &axdev->rxctl);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL,
+			 2, 2, &axdev->rxctl);
 
 	reg8[0] = AX_MAC_RX_PATH_READY | AX_MAC_TX_PATH_READY;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_PATH,
-				1, 1, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, reg8);
 
-	return 0;
+	return ax_cmd_batch_run(batch);
 }
 
 #ifdef ENABLE_QUEUE_PRIORITY
@@ -1787,92 +1901,70 @@ static int ax88279_set_bulkin_setting(struct ax_device *axdev)
 static int ax88279_link_setting(struct ax_device *axdev)
 {
 	struct ax_link_info *link_info = &axdev->link_info;
+	struct ax_cmd_batch *batch;
 	u16 medium_mode, reg16;
 	u8 reg8[3];
 	int ret;
 
+	batch = ax_cmd_batch_init(axdev, 1);
+
 	reg16 = AX_RX_CTL_STOP;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
 
-	reg16 = 0;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_PATH,
-				1, 1, &reg16);
-	if (ret < 0)
-		return ret;
+	reg8[0] = 0;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, reg8);
 
 	reg8[0] = 0xA5;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-				AX88179A_MAC_CDC_DELAY_TX, 1, 1, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_CDC_DELAY_TX,
+			 1, 1, reg8);
 
 	reg8[0] = 0x10;
 	reg8[1] = 0x04;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-				AX_PAUSE_WATERLVL_HIGH, 2, 2, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_PAUSE_WATERLVL_HIGH,
+			 2, 2, reg8);
 
 	reg8[0] = 0;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-				AX88179A_ETH_TX_GAP, 1, 1, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_ETH_TX_GAP,
+			 1, 1, reg8);
 
 	reg8[0] = 0x07;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_EP5_EHR, 1, 1,
-				&reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_EP5_EHR, 1, 1, reg8);
 
 	medium_mode = AX_MEDIUM_RECEIVE_EN | AX_MEDIUM_RXFLOW_CTRLEN |
 		      AX_MEDIUM_TXFLOW_CTRLEN;
+	if (axdev->netdev->mtu > 1500)
+		medium_mode |= AX_MEDIUM_JUMBO_EN;
 	reg8[0] = 0x28 | AX_NEW_PAUSE_EN;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX88179A_NEW_PAUSE_CTRL,
-			   1, 1, reg8);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_NEW_PAUSE_CTRL,
+			 1, 1, reg8);
+
 	switch (link_info->eth_speed) {
 	case ETHER_LINK_2500:
 		reg8[0] = 0x00;
 		reg8[1] = 0xF8;
 		reg8[2] = 0x07;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
 
 		reg8[0] = 0x78;
 		reg8[1] = (AX_LSOFC_WCNT_7_ACCESS << 5);
 		reg8[2] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
 
 		reg8[0] = 0x40;
 		reg8[1] = AX_MAC_MIQFFCTRL_FORMAT | AX_MAC_MIQFFCTRL_DROP_CRC |
 			  AX_MAC_LSO_ERR_EN;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_DATA_CDC_CNT,
-					2, 2, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_DATA_CDC_CNT, 2, 2, reg8);
 
 		reg8[0] = AX_XGMII_EN;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					 AX88179A_BFM_DATA, 1, 1, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_BFM_DATA, 1, 1, reg8);
 
 		reg8[0] = (0x1C) | AX_LSO_ENHANCE_EN;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1,
-					&reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1, reg8);
 
 		medium_mode |= AX_MEDIUM_GIGAMODE;
 		break;
@@ -1880,41 +1972,28 @@ static int ax88279_link_setting(struct ax_device *axdev)
 		reg8[0] = 0x48;
 		reg8[1] = 0xF1;
 		reg8[2] = 0x3E;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					 AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
 
 		reg8[0] = 0x78;
 		reg8[1] = (AX_LSOFC_WCNT_7_ACCESS << 5);
 		reg8[2] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
 
 		reg8[0] = 0x40;
 		reg8[1] = AX_MAC_MIQFFCTRL_FORMAT | AX_MAC_MIQFFCTRL_DROP_CRC |
 			  AX_MAC_LSO_ERR_EN;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_DATA_CDC_CNT,
-					2, 2, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_DATA_CDC_CNT, 2, 2, reg8);
 
 		reg8[0] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					 AX88179A_BFM_DATA, 1, 1, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_BFM_DATA, 1, 1, reg8);
 
 		reg8[0] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1,
-					&reg8);
-		if (ret < 0)
-			return ret;
-
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1, reg8);
 
 		medium_mode |= AX_MEDIUM_GIGAMODE;
 		break;
@@ -1922,108 +2001,83 @@ static int ax88279_link_setting(struct ax_device *axdev)
 		reg8[0] = 0x90;
 		reg8[1] = 0xE2;
 		reg8[2] = 0x7D;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					 AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
 
 		reg8[0] = 0x78;
 		reg8[1] = (AX_LSOFC_WCNT_7_ACCESS << 5);
 		reg8[2] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
 
 		reg8[0] = 0x40;
 		reg8[1] = AX_MAC_MIQFFCTRL_FORMAT | AX_MAC_MIQFFCTRL_DROP_CRC |
 			  AX_MAC_LSO_ERR_EN;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_DATA_CDC_CNT,
-					2, 2, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_DATA_CDC_CNT, 2, 2, reg8);
 
 		reg8[0] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_BFM_DATA, 1, 1, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_BFM_DATA, 1, 1, reg8);
 
 		reg8[0] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1,
-					&reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1, reg8);
 		break;
 	case ETHER_LINK_10:
 		reg8[0] = 0x90;
 		reg8[1] = 0xE2;
 		reg8[2] = 0x7D;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_TX_PAUSE_0, 3, 3, reg8);
 
 		reg8[0] = 0xFA;
 		reg8[1] = (AX_LSOFC_WCNT_7_ACCESS << 5);
 		reg8[2] = 0xFF;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_STATUS_CDC, 3, 3, reg8);
 
 		reg8[0] = 0xFA;
 		reg8[1] = AX_MAC_MIQFFCTRL_FORMAT | AX_MAC_MIQFFCTRL_DROP_CRC |
 			  AX_MAC_LSO_ERR_EN;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_RX_DATA_CDC_CNT,
-					2, 2, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_RX_DATA_CDC_CNT, 2, 2, reg8);
 
 		reg8[0] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_BFM_DATA, 1, 1, reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_BFM_DATA, 1, 1, reg8);
 
 		reg8[0] = 0;
-		ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC,
-					AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1,
-					&reg8);
-		if (ret < 0)
-			return ret;
+		ax_cmd_batch_add(batch, AX_ACCESS_MAC,
+				 AX88179A_MAC_LSO_ENHANCE_CTRL, 1, 1, reg8);
 		break;
 	default:
 		break;
 	};
 
+	ret = ax_cmd_batch_run(batch);
+	if (ret < 0)
+		return ret;
+
 	ret = ax88279_set_bulkin_setting(axdev);
 	if (ret < 0)
 		return ret;
 
+	batch = ax_cmd_batch_init(axdev, 1);
+
 	if (link_info->full_duplex)
 		medium_mode |= AX_MEDIUM_FULL_DUPLEX;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-				2, 2, &medium_mode);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
+			 2, 2, &medium_mode);
 
 	axdev->rxctl |= AX_RX_CTL_START | AX_RX_CTL_AB | AX_RX_CTL_DROPCRCERR;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_RX_CTL,
-				2, 2, &axdev->rxctl);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL,
+			 2, 2, &axdev->rxctl);
 
-	reg16 = AX_MAC_RX_PATH_READY | AX_MAC_TX_PATH_READY;
-	ret = ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_PATH,
-				1, 1, &reg16);
-	if (ret < 0)
-		return ret;
+	reg8[0] = AX_MAC_RX_PATH_READY | AX_MAC_TX_PATH_READY;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, reg8);
 
-	return 0;
+	return ax_cmd_batch_run(batch);
 }
 
 #ifdef ENABLE_QUEUE_PRIORITY
@@ -2168,9 +2222,7 @@ inline void ax88179a_rx_checksum(struct sk_buff *skb, void *pkt_hdr)
 static void ax88179a_rx_fixup(struct ax_device *axdev, struct rx_desc *desc,
 			      int *work_done, int budget)
 {
-#ifndef ENABLE_RX_TASKLET
 	struct napi_struct *napi = &axdev->napi;
-#endif
 	struct net_device *netdev = axdev->netdev;
 	struct net_device_stats *stats = ax_get_stats(netdev);
 	struct _179a_rx_pkt_header *pkt_hdr;
@@ -2219,11 +2271,7 @@ static void ax88179a_rx_fixup(struct ax_device *axdev, struct rx_desc *desc,
 
 		pkt_len = (u32)(pkt_hdr->length & 0x7FFF);
 
-#ifdef ENABLE_RX_TASKLET
-		skb = netdev_alloc_skb(netdev, pkt_len);
-#else
 		skb = napi_alloc_skb(napi, pkt_len);
-#endif
 		if (!skb) {
 			stats->rx_dropped++;
 			goto find_next_rx;
@@ -2247,17 +2295,21 @@ static void ax88179a_rx_fixup(struct ax_device *axdev, struct rx_desc *desc,
 #endif
 #ifdef ENABLE_PTP_FUNC
 		if (pkt_hdr->PTP_ind) {
-			ax_rx_get_timestamp(skb, (u64 *)pkt_hdr);
+			if (axdev->ptp_cfg &&
+			    (axdev->ptp_cfg->rx_filter != HWTSTAMP_FILTER_NONE ||
+			     test_bit(AX_PTP_CAL, &axdev->flags)))
+				ax_rx_get_timestamp(skb, (u64 *)pkt_hdr);
+			if (unlikely(test_bit(AX_PTP_CAL, &axdev->flags)))
+				ax_ptp_cal_rx(axdev, skb);
 			pkt_hdr += 2;
 		}
 #endif
 		skb->protocol = eth_type_trans(skb, netdev);
+#if KERNEL_VERSION(3, 11, 0) <= LINUX_VERSION_CODE
+		skb_mark_napi_id(skb, napi);
+#endif
 		if (*work_done < budget) {
-#ifdef ENABLE_RX_TASKLET
-			netif_receive_skb(skb);
-#else
 			napi_gro_receive(napi, skb);
-#endif
 
 			*work_done += 1;
 			stats->rx_packets++;
@@ -2343,7 +2395,9 @@ static int ax88179a_tx_fixup(struct ax_device *axdev, struct tx_desc *desc)
 		desc->skb_len += skb->len;
 		desc->skb_num += skb_shinfo(skb)->gso_segs ?: 1;
 #ifdef ENABLE_PTP_FUNC
-		if (skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP) {
+		if ((skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP) &&
+		    ax_ptp_tx_parse(skb)) {
+			AX_PTP_SKB_CB(skb)->queued = jiffies;
 			skb_queue_tail(&axdev->tx_timestamp, skb);
 			set_bit(AX_TX_TIMESTAMPS, &desc->flags);
 		} else {
@@ -2423,30 +2477,53 @@ static int ax88179a_system_resume(struct ax_device *axdev)
 	return 0;
 }
 
+static bool ax88179a_rx_fifo_idle(const u8 *reg)
+{
+	return get_unaligned_le16(reg) >= 0x11FF;
+}
+
+static bool ax88179a_usb_dc_idle(const u8 *reg)
+{
+	return reg[2] & 0x02;
+}
+
+/* Sleep between reads, the PM worker must not spin on the bus */
+static int ax88179a_suspend_wait(struct ax_device *axdev, u8 cmd, u16 value,
+				 u16 size, bool (*done)(const u8 *reg))
+{
+	unsigned long timeout;
+	u8 reg[4];
+	int ret;
+
+	timeout = jiffies + msecs_to_jiffies(AX88179A_SUSPEND_TIMEOUT);
+	do {
+		ret = ax_read_cmd_nopm(axdev, cmd, value, size, size, reg, 0);
+		if (ret < 0)
+			return ret;
+		if (done(reg))
+			return 0;
+		usleep_range(1000, 2000);
+	} while (time_before(jiffies, timeout));
+
+	return -ETIMEDOUT;
+}
+
 static int ax88179a_runtime_suspend(struct ax_device *axdev)
 {
 	u16 reg16, medium_mode;
-	u8 reg8, loop = 100;
+	u8 reg8;
 
 #ifdef ENABLE_AX88279
 #ifdef ENABLE_PTP_FUNC
 	ax88279_stop_get_ts(axdev);
 #endif
 #endif
-	while(loop--) {
-		ax_read_cmd_nopm(axdev, AX_ACCESS_MAC, 0x57, 2, 2, &reg16, 0);
-		if (reg16 >= 0x11FF)
-			break;
-		mdelay(10);
-	};
-	loop = 100;
-	while(loop--) {
-		u8 reg[4];
-		ax_read_cmd_nopm(axdev, AX88179A_USB_DC, 0x1230, 4, 4, reg, 0);
-		if (reg[2] & 0x02)
-			break;
-		mdelay(10);
-	};
+	if (ax88179a_suspend_wait(axdev, AX_ACCESS_MAC, 0x57, 2,
+				  ax88179a_rx_fifo_idle) < 0)
+		netdev_dbg(axdev->netdev, "RX FIFO busy before suspend\n");
+	if (ax88179a_suspend_wait(axdev, AX88179A_USB_DC, 0x1230, 4,
+				  ax88179a_usb_dc_idle) < 0)
+		netdev_dbg(axdev->netdev, "USB DMA busy before suspend\n");
 
 	ax_read_cmd_nopm(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE, 2, 2,
 			 &medium_mode, 0);
@@ -2493,51 +2570,55 @@ static int ax88179a_runtime_suspend(struct ax_device *axdev)
 static int ax88179a_runtime_resume(struct ax_device *axdev)
 {
 	struct ax_link_info *link_info = &axdev->link_info;
+	struct ax_cmd_batch *batch;
 	u16 reg16, medium_mode;
 	u8 reg8;
+	int ret;
 
 	if (!ax88179a_check_phy_power(axdev))
 		ax88179a_set_phy_power(axdev, true);
 
-	ax_write_cmd_nopm(axdev, AX_FW_MODE, AX_FW_MODE_179A, 0, 0, NULL);
+	ret = ax_write_cmd_nopm(axdev, AX_FW_MODE, AX_FW_MODE_179A, 0, 0, NULL);
+	if (ret < 0)
+		return ret;
 
-	ax_read_cmd_nopm(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE, 2, 2,
-			 &medium_mode, 0);
-	medium_mode &= ~AX_MEDIUM_RECEIVE_EN;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE, 2, 2,
-			  &medium_mode);
+	ret = ax_read_cmd_nopm(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
+			       2, 2, &medium_mode, 0);
+	if (ret < 0)
+		return ret;
 
-	reg8 = 0xFF;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_BM_INT_MASK,
-			  1, 1, &reg8);
+	/* One chained transfer instead of a round trip per register */
+	batch = ax_cmd_batch_init(axdev, 1);
 
-	reg8 = 0;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_BM_RX_DMA_CTL,
-			  1, 1, &reg8);
+	medium_mode &= ~AX_MEDIUM_RECEIVE_EN;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE, 2, 2,
+			 &medium_mode);
 
-	reg8 = 0;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_BM_TX_DMA_CTL,
-			  1, 1, &reg8);
+	reg8 = 0xFF;
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_BM_INT_MASK,
+			 1, 1, &reg8);
 
 	reg8 = 0;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_ARC_CTRL,
-			  1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_BM_RX_DMA_CTL,
+			 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_BM_TX_DMA_CTL,
+			 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_ARC_CTRL,
+			 1, 1, &reg8);
 
 	reg16 = AX_RX_CTL_STOP;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
 
 	reg8 = 0;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, &reg8);
-
-	reg8 = 0;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_SWP_CTRL,
-			  1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_SWP_CTRL,
+			 1, 1, &reg8);
 
 	reg16 = AX_RX_CTL_START | AX_RX_CTL_AB;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_RX_CTL, 2, 2, &reg16);
 
 	reg8 = AX_MAC_RX_PATH_READY | AX_MAC_TX_PATH_READY;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, &reg8);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX88179A_MAC_PATH, 1, 1, &reg8);
 
 	if (link_info->eth_speed == ETHER_LINK_1000)
 		medium_mode |= AX_MEDIUM_GIGAMODE;
@@ -2546,8 +2627,19 @@ static int ax88179a_runtime_resume(struct ax_device *axdev)
 
 	medium_mode |= AX_MEDIUM_RECEIVE_EN | AX_MEDIUM_RXFLOW_CTRLEN |
 		       AX_MEDIUM_TXFLOW_CTRLEN;
-	ax_write_cmd_nopm(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE, 2, 2,
-			  &medium_mode);
+	ax_cmd_batch_add(batch, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE, 2, 2,
+			 &medium_mode);
+
+	ret = ax_cmd_batch_run(batch);
+	if (ret < 0)
+		return ret;
+
+#ifdef ENABLE_AX88279
+#ifdef ENABLE_PTP_FUNC
+	/* Runtime suspend stopped EP4, restart TX timestamp collection */
+	ax88279_start_get_ts(axdev);
+#endif
+#endif
 
 	return 0;
 }
@@ -2556,6 +2648,7 @@ static int ax88179a_runtime_resume(struct ax_device *axdev)
 const struct driver_info ax88279_info = {
 	.bind		= ax88179a_bind,
 	.unbind		= ax88179a_unbind,
+	.late_init	= ax88179a_late_init,
 	.hw_init	= ax88179a_hw_init,
 	.stop		= ax88179a_stop,
 #ifdef ENABLE_QUEUE_PRIORITY
@@ -2584,6 +2677,7 @@ const struct driver_info ax88279_info = {
 const struct driver_info ax88179a_info = {
 	.bind		= ax88179a_bind,
 	.unbind		= ax88179a_unbind,
+	.late_init	= ax88179a_late_init,
 	.hw_init	= ax88179a_hw_init,
 	.stop		= ax88179a_stop,
 #ifdef ENABLE_QUEUE_PRIORITY
@@ -2609,6 +2703,7 @@ const struct driver_info ax88179a_info = {
 const struct driver_info ax88772d_info = {
 	.bind		= ax88179a_bind,
 	.unbind		= ax88179a_unbind,
+	.late_init	= ax88179a_late_init,
 	.hw_init	= ax88179a_hw_init,
 	.stop		= ax88179a_stop,
 #ifdef ENABLE_QUEUE_PRIORITY
@@ -35,6 +35,7 @@
 #define AX88279_HIGH_QUEUE_POINT	0x70
 #endif
 #define AX88179A_AUTODETACH_DELAY	(5UL << 8)
+#define AX88179A_SUSPEND_TIMEOUT	1000		//ms
 
 #define AX8179A_WAKEUP_SETTING		0x07
 #define AX88179A_PBUS_REG		0x10
@@ -58,11 +59,14 @@
 #define AX88179A_FLASH_WDIS		0x23
 #define AX88179A_FLASH_WRITE		0x24
 #define AX88179A_FLASH_EARSE_ALL	0x25
+#define AX88179A_VLAN_ID_ADDRESS	0x2A
 #define AX88179A_VLAN_ID_CONTROL	0x2B
 	#define AX_VLAN_CONTROL_WE		0x0001
 	#define AX_VLAN_CONTROL_RD		0x0002
 	#define AX_VLAN_CONTROL_VSO		0x0010
 	#define AX_VLAN_CONTROL_VFE		0x0020
+#define AX88179A_VLAN_ID_DATA0		0x2C
+#define AX88179A_VLAN_ID_DATA1		0x2D
 #define AX88179A_MAC_BM_INT_MASK	0x41
 #define AX88179A_MAC_BM_RX_DMA_CTL	0x43
 #define AX88179A_MAC_BM_TX_DMA_CTL	0x46
@@ -243,4 +247,11 @@ int ax88179a_siocdevprivate(struct net_device *netdev, struct ifreq *rq,
 #endif
 int ax88179a_ioctl(struct net_device *net, struct ifreq *rq, int cmd);
 void ax88179a_set_multicast(struct net_device *net);
+#if KERNEL_VERSION(3, 10, 0) <= LINUX_VERSION_CODE
+int ax88179a_set_vlan_ctrl(struct ax_device *axdev,
+			   netdev_features_t features);
+int ax88179a_vlan_rx_add_vid(struct net_device *netdev, __be16 proto, u16 vid);
+int ax88179a_vlan_rx_kill_vid(struct net_device *netdev, __be16 proto,
+			      u16 vid);
+#endif
 #endif /* End of __ASIX_AX88179A_772D_H */
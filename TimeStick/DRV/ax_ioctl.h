@@ -54,6 +54,7 @@
 #define AX88179A_IEEE_TEST		10
 #define AX88179A_AUTOSUSPEND_EN		11
 #define AX88179A_ERASE_SECTOR_FLASH	12
+#define AX88179A_PTP_DELAY_CAL		13
 
 #define IEEE_1000M1			0
 #define IEEE_1000M2			1
@@ -162,6 +163,12 @@ struct _ax88179a_autosuspend {
 	unsigned int enable;
 };
 
+struct _ax88179a_ptp_cal {
+	int tx_delay;
+	int rx_delay;
+	int status;
+};
+
 struct _ax_ioctl_command {
 	unsigned short	ioctl_cmd;
 	unsigned char	sig[32];
@@ -175,6 +182,7 @@ struct _ax_ioctl_command {
 		struct _ax88179a_ieee		ieee;
 		struct _ax_usb_command		usb_cmd;
 		struct _ax88179a_autosuspend	autosuspend;
+		struct _ax88179a_ptp_cal	ptp_cal;
 	};
 };
 
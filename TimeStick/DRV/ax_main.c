@@ -50,6 +50,24 @@ static int bifg = -1;
 module_param(bifg, int, 0);
 MODULE_PARM_DESC(bifg, "RX Bulk Inter Frame Gap");
 
+static int tx_preempt = 1;
+module_param(tx_preempt, int, 0644);
+MODULE_PARM_DESC(tx_preempt, "RX poll yields to timestamped TX frames");
+
+static int link_poll = -1;
+module_param(link_poll, int, 0644);
+MODULE_PARM_DESC(link_poll, "Poll PHY link state: -1=when intr is unreliable, 0=off, 1=always");
+
+#if KERNEL_VERSION(5, 12, 0) <= LINUX_VERSION_CODE
+static int napi_threaded;
+module_param(napi_threaded, int, 0);
+MODULE_PARM_DESC(napi_threaded, "Run RX/TX processing in a NAPI kthread");
+
+static char *napi_cpus;
+module_param(napi_cpus, charp, 0);
+MODULE_PARM_DESC(napi_cpus, "CPU list the RX/TX NAPI kthreads are bound to");
+#endif
+
 static int
 ax_submit_rx(struct ax_device *netdev, struct rx_desc *desc, gfp_t mem_flags);
 static void ax_set_carrier(struct ax_device *axdev);
@@ -286,10 +304,23 @@ static const char ax_gstrings[][ETH_GSTRING_LEN] = {
 	"bulkout_error",
 	"bulkint_complete",
 	"bulkint_error",
+	"reg_shadow_hits",
+	"reg_shadow_misses",
+	"carrier_up_last_us",
+	"carrier_up_max_us",
+	"link_detect_last_us",
+	"link_detect_max_us",
+	"link_polls",
 #ifdef ENABLE_QUEUE_PRIORITY
 	"ep5_count",
 	"ep3_count",
 #endif
+#ifdef ENABLE_PTP_FUNC
+	"ptp_ep4_gap_last_ns",
+	"ptp_ep4_gap_max_ns",
+	"ptp_ep4_empty",
+	"ptp_resume_ts_us",
+#endif
 #ifdef ENABLE_MACSEC_FUNC
 	"macsec_rx_in_pkts",
 	"macsec_rx_out_pkts",
@@ -372,10 +403,23 @@ void ax_get_ethtool_stats(struct net_device *netdev,
 	*temp++ = axdev->bulkout_error;
 	*temp++ = axdev->bulkint_complete;
 	*temp++ = axdev->bulkint_error;
+	*temp++ = axdev->reg_shadow_hits;
+	*temp++ = axdev->reg_shadow_misses;
+	*temp++ = axdev->carrier_up_last_us;
+	*temp++ = axdev->carrier_up_max_us;
+	*temp++ = axdev->link_detect_last_us;
+	*temp++ = axdev->link_detect_max_us;
+	*temp++ = axdev->link_polls;
 #ifdef ENABLE_QUEUE_PRIORITY
 	*temp++ = axdev->ep5_count;
 	*temp++ = axdev->ep3_count;
 #endif
+#ifdef ENABLE_PTP_FUNC
+	*temp++ = axdev->ptp_ep4_gap_last;
+	*temp++ = axdev->ptp_ep4_gap_max;
+	*temp++ = axdev->ptp_ep4_empty;
+	*temp++ = axdev->ptp_resume_ts_us;
+#endif
 #ifdef ENABLE_AX88279
 #ifdef ENABLE_MACSEC_FUNC
 	if (axdev->chip_version >= AX_VERSION_AX88279) {
@@ -485,6 +529,28 @@ void ax_get_regs(struct net_device *netdev,
 		ax_read_cmd(axdev, AX_ACCESS_MAC, i, 1, 1, &data[i], 0);
 }
 
+/*
+ * Vendor commands normally bounce through the per-device cmd_buf. A
+ * caller that finds it busy, or needs more than AX_CMD_BUF_SIZE bytes,
+ * gets a buffer of its own instead of waiting.
+ */
+static void *ax_cmd_buf_get(struct ax_device *axdev, u16 size)
+{
+	if (size <= AX_CMD_BUF_SIZE && axdev->cmd_buf &&
+	    mutex_trylock(&axdev->cmd_buf_lock))
+		return axdev->cmd_buf;
+
+	return kmalloc(size, GFP_KERNEL);
+}
+
+static void ax_cmd_buf_put(struct ax_device *axdev, void *buf)
+{
+	if (buf == axdev->cmd_buf)
+		mutex_unlock(&axdev->cmd_buf_lock);
+	else
+		kfree(buf);
+}
+
 static int __ax_usb_read_cmd(struct ax_device *axdev, u8 cmd, u8 reqtype,
 			     u16 value, u16 index, void *data, u16 size)
 {
@@ -492,7 +558,7 @@ static int __ax_usb_read_cmd(struct ax_device *axdev, u8 cmd, u8 reqtype,
 	int err = -ENOMEM;
 
 	if (size) {
-		buf = kzalloc(size, GFP_KERNEL);
+		buf = ax_cmd_buf_get(axdev, size);
 		if (!buf)
 			goto out;
 	}
@@ -508,7 +574,8 @@ static int __ax_usb_read_cmd(struct ax_device *axdev, u8 cmd, u8 reqtype,
 				   "Huh? Data requested but thrown away.\n");
 	}
 
-	kfree(buf);
+	if (buf)
+		ax_cmd_buf_put(axdev, buf);
 out:
 	return err;
 }
@@ -520,9 +587,10 @@ static int __ax_usb_write_cmd(struct ax_device *axdev, u8 cmd, u8 reqtype,
 	int err = -ENOMEM;
 
 	if (data) {
-		buf = kmemdup(data, size, GFP_KERNEL);
+		buf = ax_cmd_buf_get(axdev, size);
 		if (!buf)
 			goto out;
+		memcpy(buf, data, size);
 	} else {
 		if (size) {
 			WARN_ON_ONCE(1);
@@ -534,7 +602,8 @@ static int __ax_usb_write_cmd(struct ax_device *axdev, u8 cmd, u8 reqtype,
 	err = usb_control_msg(axdev->udev, usb_sndctrlpipe(axdev->udev, 0),
 			      cmd, reqtype, value, index, buf, size,
 			      USB_CTRL_SET_TIMEOUT);
-	kfree(buf);
+	if (buf)
+		ax_cmd_buf_put(axdev, buf);
 
 out:
 	return err;
@@ -587,6 +656,105 @@ static int __ax_write_cmd_nopm(struct ax_device *axdev, u8 cmd, u8 reqtype,
 				  data, size);
 }
 
+/*
+ * Shadow of the AX_ACCESS_MAC register space. A register only becomes
+ * valid once ax_update_reg() has read it, so only registers the driver
+ * explicitly treats as its own are ever served from here. Every write
+ * to a valid register is mirrored, and the whole shadow is dropped
+ * whenever the device may have lost its state.
+ */
+static bool ax_reg_shadow_range(u8 cmd, u16 value, u16 index, u16 size)
+{
+	return cmd == AX_ACCESS_MAC && index == size &&
+	       value + size <= AX_REG_SHADOW_SIZE;
+}
+
+static void ax_reg_shadow_write(struct ax_device *axdev, u8 cmd, u16 value,
+				u16 index, u16 size, const void *data)
+{
+	const u8 *buf = data;
+	unsigned long flags;
+	int i;
+
+	if (!data || !ax_reg_shadow_range(cmd, value, index, size))
+		return;
+
+	spin_lock_irqsave(&axdev->reg_shadow_lock, flags);
+	for (i = 0; i < size; i++) {
+		if (test_bit(value + i, axdev->reg_shadow_valid))
+			axdev->reg_shadow[value + i] = buf[i];
+	}
+	spin_unlock_irqrestore(&axdev->reg_shadow_lock, flags);
+}
+
+static void ax_reg_shadow_fill(struct ax_device *axdev, u16 reg, u16 size,
+			       const u8 *buf)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&axdev->reg_shadow_lock, flags);
+	for (i = 0; i < size; i++) {
+		axdev->reg_shadow[reg + i] = buf[i];
+		set_bit(reg + i, axdev->reg_shadow_valid);
+	}
+	spin_unlock_irqrestore(&axdev->reg_shadow_lock, flags);
+}
+
+static void ax_reg_shadow_drop(struct ax_device *axdev, u16 reg, u16 size)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&axdev->reg_shadow_lock, flags);
+	for (i = 0; i < size; i++)
+		clear_bit(reg + i, axdev->reg_shadow_valid);
+	spin_unlock_irqrestore(&axdev->reg_shadow_lock, flags);
+}
+
+static bool ax_reg_shadow_read(struct ax_device *axdev, u16 reg, u16 size,
+			       u8 *buf)
+{
+	unsigned long flags;
+	bool hit = true;
+	int i;
+
+	spin_lock_irqsave(&axdev->reg_shadow_lock, flags);
+	for (i = 0; i < size; i++) {
+		if (!test_bit(reg + i, axdev->reg_shadow_valid)) {
+			hit = false;
+			break;
+		}
+		buf[i] = axdev->reg_shadow[reg + i];
+	}
+	if (hit)
+		axdev->reg_shadow_hits++;
+	else
+		axdev->reg_shadow_misses++;
+	spin_unlock_irqrestore(&axdev->reg_shadow_lock, flags);
+
+	return hit;
+}
+
+static void ax_reg_shadow_invalidate(struct ax_device *axdev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&axdev->reg_shadow_lock, flags);
+	bitmap_zero(axdev->reg_shadow_valid, AX_REG_SHADOW_SIZE);
+	spin_unlock_irqrestore(&axdev->reg_shadow_lock, flags);
+}
+
+/* The device lost its register state, link_reset must start from scratch */
+static void ax_hw_state_reset(struct ax_device *axdev)
+{
+	ax_reg_shadow_invalidate(axdev);
+#ifdef ENABLE_PTP_FUNC
+	if (axdev->ptp_cfg)
+		axdev->ptp_cfg->hw_ready = 0;
+#endif
+}
+
 static int __asix_read_cmd(struct ax_device *axdev, u8 cmd, u16 value,
 			   u16 index, u16 size, void *data, int in_pm)
 {
@@ -627,6 +795,8 @@ static int __asix_write_cmd(struct ax_device *axdev, u8 cmd, u16 value,
 		dev_warn(&axdev->intf->dev,
 			 "Failed to write reg %04X_%04X_%04X_%04X (err %d)",
 			 cmd, value, index, size, ret);
+	else
+		ax_reg_shadow_write(axdev, cmd, value, index, size, data);
 
 	return ret;
 }
@@ -675,6 +845,38 @@ int ax_write_cmd_nopm(struct ax_device *dev, u8 cmd, u16 value,
 	return ret;
 }
 
+/*
+ * Read-modify-write of a driver-owned 8 or 16-bit MAC register. Once the
+ * register is in the shadow this costs a single write transfer.
+ */
+int ax_update_reg(struct ax_device *axdev, u16 reg, u16 size, u16 clear,
+		  u16 set)
+{
+	u8 buf[2] = {0};
+	u16 val;
+	int ret;
+
+	if (size != 1 && size != 2)
+		return -EINVAL;
+
+	if (!ax_reg_shadow_read(axdev, reg, size, buf)) {
+		ret = __asix_read_cmd(axdev, AX_ACCESS_MAC, reg, size, size,
+				      buf, 0);
+		if (ret < 0)
+			return ret;
+		if (ret != size)
+			return -EIO;
+		ax_reg_shadow_fill(axdev, reg, size, buf);
+	}
+
+	val = buf[0] | (buf[1] << 8);
+	val = (val & ~clear) | set;
+	buf[0] = val & 0xFF;
+	buf[1] = val >> 8;
+
+	return __asix_write_cmd(axdev, AX_ACCESS_MAC, reg, size, size, buf, 0);
+}
+
 int ax_read_cmd(struct ax_device *dev, u8 cmd, u16 value, u16 index, u16 size,
 		void *data, int eflag)
 {
@@ -726,17 +928,348 @@ static void ax_async_write_callback(struct urb *urb)
 #endif
 {
 	struct _async_cmd_handle *asyncdata = (typeof(asyncdata))urb->context;
+	struct usb_ctrlrequest *req = asyncdata->req;
 
+	/* Mirror into the shadow only once the device has taken the write */
 	if (urb->status < 0)
 		dev_err(&asyncdata->axdev->intf->dev,
 			"ax_async_write_callback() failed with %d",
 			urb->status);
+	else
+		ax_reg_shadow_write(asyncdata->axdev, req->bRequest,
+				    le16_to_cpu(req->wValue),
+				    le16_to_cpu(req->wIndex),
+				    le16_to_cpu(req->wLength),
+				    urb->transfer_buffer);
 
 	kfree(asyncdata->req);
 	kfree(asyncdata);
 	usb_free_urb(urb);
 }
 
+/*
+ * rx-mode updates from ndo_set_rx_mode run in atomic context and can come
+ * in bursts. They share one preallocated control URB: only the latest
+ * requested filter and rxctl are kept, and a write is sent only when it
+ * differs from what the register shadow says the device already has.
+ */
+#if KERNEL_VERSION(2, 6, 20) > LINUX_VERSION_CODE
+static void ax_rx_mode_callback(struct urb *urb, struct pt_regs *regs);
+#else
+static void ax_rx_mode_callback(struct urb *urb);
+#endif
+
+static bool ax_rx_mode_differs(struct ax_device *axdev, u16 reg, u16 size,
+			       const u8 *val)
+{
+	u8 cur[AX_MCAST_FILTER_SIZE];
+
+	return !ax_reg_shadow_read(axdev, reg, size, cur) ||
+	       memcmp(cur, val, size);
+}
+
+/* Called with rx_mode.lock held */
+static void ax_rx_mode_failed(struct ax_device *axdev, u16 reg, int err)
+{
+	if (net_ratelimit())
+		netdev_warn(axdev->netdev, "rx mode write to %02X failed: %d\n",
+			    reg, err);
+
+	/* The URB was killed or the device is gone */
+	if (err == -ENOENT || err == -ECONNRESET || err == -ESHUTDOWN ||
+	    err == -ENODEV)
+		return;
+
+	/* The update stays dirty, the link work sends it again */
+	set_bit(AX_RX_MODE_RETRY, &axdev->flags);
+	schedule_delayed_work(&axdev->schedule,
+			      msecs_to_jiffies(AX_RX_MODE_RETRY_MS));
+}
+
+/* Called with rx_mode.lock held */
+static void ax_rx_mode_kick(struct ax_device *axdev)
+{
+	struct ax_rx_mode *rx_mode = &axdev->rx_mode;
+	struct usb_ctrlrequest *req = rx_mode->req;
+	u16 reg, size;
+	__le16 rxctl;
+	int ret;
+
+	if (rx_mode->busy || !rx_mode->dirty)
+		return;
+
+	rxctl = cpu_to_le16(rx_mode->rxctl);
+	if (rx_mode->use_filter &&
+	    ax_rx_mode_differs(axdev, AX_MULTI_FILTER_ARRY,
+			       AX_MCAST_FILTER_SIZE, rx_mode->m_filter)) {
+		reg = AX_MULTI_FILTER_ARRY;
+		size = AX_MCAST_FILTER_SIZE;
+		memcpy(rx_mode->buf, rx_mode->m_filter, size);
+	} else if (ax_rx_mode_differs(axdev, AX_RX_CTL, 2, (u8 *)&rxctl)) {
+		reg = AX_RX_CTL;
+		size = 2;
+		memcpy(rx_mode->buf, &rxctl, size);
+	} else {
+		rx_mode->dirty = false;
+		return;
+	}
+
+	req->bRequestType = USB_DIR_OUT | USB_TYPE_VENDOR | USB_RECIP_DEVICE;
+	req->bRequest = AX_ACCESS_MAC;
+	req->wValue = cpu_to_le16(reg);
+	req->wIndex = cpu_to_le16(size);
+	req->wLength = cpu_to_le16(size);
+
+	usb_fill_control_urb(rx_mode->urb, axdev->udev,
+			     usb_sndctrlpipe(axdev->udev, 0), (void *)req,
+			     rx_mode->buf, size, ax_rx_mode_callback, axdev);
+
+	ret = usb_submit_urb(rx_mode->urb, GFP_ATOMIC);
+	if (ret < 0) {
+		ax_rx_mode_failed(axdev, reg, ret);
+		return;
+	}
+	rx_mode->busy = true;
+}
+
+#if KERNEL_VERSION(2, 6, 20) > LINUX_VERSION_CODE
+static void ax_rx_mode_callback(struct urb *urb, struct pt_regs *regs)
+#else
+static void ax_rx_mode_callback(struct urb *urb)
+#endif
+{
+	struct ax_device *axdev = (struct ax_device *)urb->context;
+	struct ax_rx_mode *rx_mode = &axdev->rx_mode;
+	struct usb_ctrlrequest *req = rx_mode->req;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rx_mode->lock, flags);
+	rx_mode->busy = false;
+	if (urb->status < 0) {
+		/* Register state is unknown now, force a rewrite next time */
+		ax_reg_shadow_drop(axdev, le16_to_cpu(req->wValue),
+				   le16_to_cpu(req->wLength));
+		ax_rx_mode_failed(axdev, le16_to_cpu(req->wValue),
+				  urb->status);
+	} else {
+		ax_reg_shadow_fill(axdev, le16_to_cpu(req->wValue),
+				   le16_to_cpu(req->wLength), rx_mode->buf);
+		ax_rx_mode_kick(axdev);
+	}
+	spin_unlock_irqrestore(&rx_mode->lock, flags);
+}
+
+static void ax_rx_mode_retry(struct ax_device *axdev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&axdev->rx_mode.lock, flags);
+	ax_rx_mode_kick(axdev);
+	spin_unlock_irqrestore(&axdev->rx_mode.lock, flags);
+}
+
+void ax_set_rx_mode_async(struct ax_device *axdev, u16 rxctl,
+			  const u8 *m_filter)
+{
+	struct ax_rx_mode *rx_mode = &axdev->rx_mode;
+	unsigned long flags;
+
+	spin_lock_irqsave(&rx_mode->lock, flags);
+	rx_mode->rxctl = rxctl;
+	rx_mode->use_filter = !!m_filter;
+	if (m_filter)
+		memcpy(rx_mode->m_filter, m_filter, AX_MCAST_FILTER_SIZE);
+	rx_mode->dirty = true;
+	ax_rx_mode_kick(axdev);
+	spin_unlock_irqrestore(&rx_mode->lock, flags);
+}
+
+static int ax_alloc_cmd_res(struct ax_device *axdev)
+{
+	struct ax_rx_mode *rx_mode = &axdev->rx_mode;
+
+	mutex_init(&axdev->cmd_buf_lock);
+	spin_lock_init(&axdev->reg_shadow_lock);
+	spin_lock_init(&rx_mode->lock);
+
+	axdev->cmd_buf = kmalloc(AX_CMD_BUF_SIZE, GFP_KERNEL);
+	rx_mode->req = kmalloc(sizeof(*rx_mode->req), GFP_KERNEL);
+	rx_mode->buf = kmalloc(AX_MCAST_FILTER_SIZE, GFP_KERNEL);
+	rx_mode->urb = usb_alloc_urb(0, GFP_KERNEL);
+	if (!axdev->cmd_buf || !rx_mode->req || !rx_mode->buf ||
+	    !rx_mode->urb)
+		return -ENOMEM;
+
+	axdev->cmd_batch = kzalloc(sizeof(*axdev->cmd_batch), GFP_KERNEL);
+	if (!axdev->cmd_batch)
+		return -ENOMEM;
+
+	axdev->cmd_batch->axdev = axdev;
+	axdev->cmd_batch->entry = kcalloc(AX_CMD_BATCH_MAX,
+					  sizeof(*axdev->cmd_batch->entry),
+					  GFP_KERNEL);
+	axdev->cmd_batch->urb = usb_alloc_urb(0, GFP_KERNEL);
+	if (!axdev->cmd_batch->entry || !axdev->cmd_batch->urb)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void ax_free_cmd_res(struct ax_device *axdev)
+{
+	struct ax_rx_mode *rx_mode = &axdev->rx_mode;
+
+	usb_kill_urb(rx_mode->urb);
+	usb_free_urb(rx_mode->urb);
+	kfree(rx_mode->buf);
+	kfree(rx_mode->req);
+	kfree(axdev->cmd_buf);
+	if (axdev->cmd_batch) {
+		usb_free_urb(axdev->cmd_batch->urb);
+		kfree(axdev->cmd_batch->entry);
+		kfree(axdev->cmd_batch);
+	}
+}
+
+/*
+ * Write batches: vendor writes are queued with ax_cmd_batch_add() and sent
+ * by ax_cmd_batch_run() as a chain of control URBs. Each completion
+ * submits the next write, so the caller sleeps once for the whole batch
+ * instead of once per register. The chain stops at the first failure.
+ * There is one preallocated batch per device, owned by the holder of
+ * axdev->control.
+ */
+#if KERNEL_VERSION(2, 6, 20) > LINUX_VERSION_CODE
+static void ax_cmd_batch_callback(struct urb *urb, struct pt_regs *regs);
+#else
+static void ax_cmd_batch_callback(struct urb *urb);
+#endif
+
+static void ax_cmd_batch_fill(struct ax_cmd_batch *batch)
+{
+	struct ax_cmd_batch_entry *entry = &batch->entry[batch->next];
+	struct usb_device *udev = batch->axdev->udev;
+
+	usb_fill_control_urb(batch->urb, udev, usb_sndctrlpipe(udev, 0),
+			     (void *)&entry->req, entry->data,
+			     le16_to_cpu(entry->req.wLength),
+			     ax_cmd_batch_callback, batch);
+}
+
+#if KERNEL_VERSION(2, 6, 20) > LINUX_VERSION_CODE
+static void ax_cmd_batch_callback(struct urb *urb, struct pt_regs *regs)
+#else
+static void ax_cmd_batch_callback(struct urb *urb)
+#endif
+{
+	struct ax_cmd_batch *batch = (typeof(batch))urb->context;
+	struct ax_cmd_batch_entry *entry = &batch->entry[batch->next];
+	int status = urb->status;
+
+	if (status < 0)
+		goto done;
+
+	ax_reg_shadow_write(batch->axdev, entry->req.bRequest,
+			    le16_to_cpu(entry->req.wValue),
+			    le16_to_cpu(entry->req.wIndex),
+			    le16_to_cpu(entry->req.wLength), entry->data);
+
+	if (++batch->next < batch->count) {
+		ax_cmd_batch_fill(batch);
+		status = usb_submit_urb(urb, GFP_ATOMIC);
+		if (status == 0)
+			return;
+	}
+done:
+	batch->status = status;
+	complete(&batch->done);
+}
+
+struct ax_cmd_batch *ax_cmd_batch_init(struct ax_device *axdev, int in_pm)
+{
+	struct ax_cmd_batch *batch = axdev->cmd_batch;
+
+	lockdep_assert_held(&axdev->control);
+
+	batch->in_pm = in_pm;
+	batch->count = 0;
+	batch->next = 0;
+	batch->status = 0;
+	init_completion(&batch->done);
+
+	return batch;
+}
+
+void ax_cmd_batch_add(struct ax_cmd_batch *batch, u8 cmd, u16 value,
+		      u16 index, u16 size, const void *data)
+{
+	struct ax_cmd_batch_entry *entry;
+
+	if (batch->status < 0)
+		return;
+
+	if (WARN_ON_ONCE(batch->count == AX_CMD_BATCH_MAX ||
+			 size > AX_CMD_BATCH_DATA)) {
+		batch->status = -EINVAL;
+		return;
+	}
+
+	entry = &batch->entry[batch->count++];
+	entry->req.bRequestType = USB_DIR_OUT | USB_TYPE_VENDOR |
+				  USB_RECIP_DEVICE;
+	entry->req.bRequest = cmd;
+	entry->req.wValue = cpu_to_le16(value);
+	entry->req.wIndex = cpu_to_le16(index);
+	entry->req.wLength = cpu_to_le16(size);
+	memcpy(entry->data, data, size);
+	if (size == 2)
+		cpu_to_le16s((u16 *)entry->data);
+}
+
+int ax_cmd_batch_run(struct ax_cmd_batch *batch)
+{
+	struct ax_device *axdev = batch->axdev;
+	unsigned long timeout;
+	int ret = batch->status;
+
+	if (ret < 0 || !batch->count)
+		goto out;
+
+	if (!batch->in_pm) {
+		ret = usb_autopm_get_interface(axdev->intf);
+		if (ret < 0)
+			goto out;
+	}
+
+	ax_cmd_batch_fill(batch);
+	ret = usb_submit_urb(batch->urb, batch->in_pm ? GFP_NOIO : GFP_KERNEL);
+	if (ret == 0) {
+		timeout = msecs_to_jiffies(USB_CTRL_SET_TIMEOUT) *
+			  batch->count;
+		if (!wait_for_completion_timeout(&batch->done, timeout)) {
+			usb_kill_urb(batch->urb);
+			ret = -ETIMEDOUT;
+		} else {
+			ret = batch->status;
+		}
+	}
+
+	if (!batch->in_pm)
+		usb_autopm_put_interface(axdev->intf);
+
+	if (unlikely(ret < 0)) {
+		struct usb_ctrlrequest *req = &batch->entry[batch->next].req;
+
+		dev_warn(&axdev->intf->dev,
+			 "Failed to write reg %04X_%04X_%04X_%04X (err %d)",
+			 req->bRequest, le16_to_cpu(req->wValue),
+			 le16_to_cpu(req->wIndex), le16_to_cpu(req->wLength),
+			 ret);
+	}
+out:
+	return ret;
+}
+
 int ax_write_cmd_async(struct ax_device *axdev, u8 cmd, u16 value, u16 index,
 		       u16 size, void *data)
 {
@@ -906,11 +1439,7 @@ static void ax_read_bulk_callback(struct urb *urb)
 		spin_lock(&axdev->rx_lock);
 		list_add_tail(&desc->list, &axdev->rx_done);
 		spin_unlock(&axdev->rx_lock);
-#ifdef ENABLE_RX_TASKLET
-		tasklet_schedule(&axdev->rx_tl);
-#else
 		napi_schedule(&axdev->napi);
-#endif
 		return;
 	case -ESHUTDOWN:
 		ax_set_unplug(axdev);
@@ -985,13 +1514,52 @@ void ax_write_bulk_callback(struct urb *urb)
 		return;
 
 	if (ax_check_tx_queue_not_empty(axdev) >= 0)
-#ifdef ENABLE_TX_TASKLET
-		tasklet_schedule(&axdev->tx_tl);
+		napi_schedule(&axdev->tx_napi);
+}
+
+static bool ax_link_poll_active(struct ax_device *axdev)
+{
+#ifdef ENABLE_DWC3_ENHANCE
+	/* The interrupt endpoint does not report link state in this mode */
+	return true;
 #else
-		napi_schedule(&axdev->napi);
+	if (link_poll >= 0)
+		return link_poll;
+
+	return test_bit(AX_INTR_UNRELIABLE, &axdev->flags);
 #endif
 }
 
+static void ax_intr_unreliable(struct ax_device *axdev)
+{
+	if (test_and_set_bit(AX_INTR_UNRELIABLE, &axdev->flags))
+		return;
+
+	if (ax_link_poll_active(axdev))
+		mod_delayed_work(system_wq, &axdev->int_polling_work, 0);
+}
+
+/*
+ * Record a link state sample. On a change, the time since the previous
+ * sample bounds how late the change was seen. Returns true on a change.
+ */
+static bool ax_link_sample(struct ax_device *axdev, u8 link)
+{
+	u64 now = ktime_to_ns(ktime_get());
+	bool changed = link != axdev->link_sampled;
+
+	if (changed && axdev->link_sample_ns) {
+		axdev->link_detect_last_us =
+			div_u64(now - axdev->link_sample_ns, NSEC_PER_USEC);
+		if (axdev->link_detect_last_us > axdev->link_detect_max_us)
+			axdev->link_detect_max_us = axdev->link_detect_last_us;
+	}
+	axdev->link_sampled = link;
+	axdev->link_sample_ns = now;
+
+	return changed;
+}
+
 static void ax_intr_callback(struct urb *urb)
 {
 	struct ax_device *axdev;
@@ -1028,25 +1596,36 @@ static void ax_intr_callback(struct urb *urb)
 	case -EPROTO:
 		netif_err(axdev, intr, axdev->netdev,
 			  "Stop submitting intr, status %d\n", status);
+		ax_intr_unreliable(axdev);
 		return;
 	case -EOVERFLOW:
 		netif_err(axdev, intr, axdev->netdev,
 			  "intr status -EOVERFLOW\n");
+		ax_intr_unreliable(axdev);
 		goto resubmit;
 	default:
 		netif_err(axdev, intr, axdev->netdev,
 			  "intr status %d\n", status);
+		ax_intr_unreliable(axdev);
 		goto resubmit;
 	}
 
 	event = urb->transfer_buffer;
 	le64_to_cpus((u64 *)event);
+	/* PHY is in loopback for PTP delay calibration */
+	if (test_bit(AX_PTP_CAL, &axdev->flags))
+		goto resubmit;
 #ifndef ENABLE_DWC3_ENHANCE
-#ifndef ENABLE_INT_POLLING
+	if (link_poll == 1)
+		goto resubmit;
+
 	axdev->link = event->link & AX_INT_PPLS_LINK;
+	ax_link_sample(axdev, axdev->link);
 
 	if (axdev->link) {
 		if (!netif_carrier_ok(axdev->netdev)) {
+			if (!axdev->link_up_ns)
+				axdev->link_up_ns = ktime_to_ns(ktime_get());
 			axdev->intr_link_info = event->link_info;
 			set_bit(AX_LINK_CHG, &axdev->flags);
 			schedule_delayed_work(&axdev->schedule, 0);
@@ -1058,7 +1637,6 @@ static void ax_intr_callback(struct urb *urb)
 			schedule_delayed_work(&axdev->schedule, 0);
 		}
 	}
-#endif
 #else
 	if (event->link & AX_INT_PPLS_LINK) {
 		if (!axdev->intr_not_first_link_up) {
@@ -1084,29 +1662,60 @@ resubmit:
 	} else if (res) {
 		netif_err(axdev, intr, axdev->netdev,
 			  "can't resubmit intr, status %d\n", res);
+		ax_intr_unreliable(axdev);
 	}
 }
-#ifdef ENABLE_INT_POLLING
+
 static void __int_polling_work(struct work_struct *work)
 {
 	struct ax_device *axdev = container_of(work,
 				     struct ax_device, int_polling_work.work);
+	struct net_device *netdev = axdev->netdev;
+	unsigned long rx_packets = ax_get_stats(netdev)->rx_packets;
+	u8 flow = axdev->link_poll_flow;
 	u16 bmsr;
 
 	if (test_bit(AX_UNPLUG, &axdev->flags) ||
 	    !test_bit(AX_ENABLE, &axdev->flags))
 		return;
 
+	if (!ax_link_poll_active(axdev) ||
+	    test_bit(AX_PTP_CAL, &axdev->flags)) {
+		schedule_delayed_work(&axdev->int_polling_work,
+				      msecs_to_jiffies(INT_POLLING_TIMER));
+		return;
+	}
+
+	/* Frames still arriving prove the link is up, skip the MDIO read */
+	axdev->link_poll_flow = rx_packets != axdev->link_poll_rx;
+	axdev->link_poll_rx = rx_packets;
+	if (axdev->link_poll_flow && netif_carrier_ok(netdev)) {
+		ax_link_sample(axdev, 1);
+		goto out;
+	}
+
 	if (!mutex_trylock(&axdev->control)) {
 		schedule_delayed_work(&axdev->int_polling_work, 0);
 		return;
 	}
 
-	bmsr = ax_mdio_read(axdev->netdev, axdev->mii.phy_id, MII_BMSR);
+	bmsr = ax_mdio_read(netdev, axdev->mii.phy_id, MII_BMSR);
+	axdev->link_polls++;
 	axdev->link = bmsr & BMSR_LSTATUS;
+
+	/* Poll fast after a change or a traffic stall, back off when stable */
+	if (ax_link_sample(axdev, axdev->link) || flow)
+		axdev->link_poll_ms = INT_POLLING_MIN;
+	else
+		axdev->link_poll_ms = min_t(u16, axdev->link_poll_ms * 2,
+					    INT_POLLING_TIMER);
+
 	if (axdev->link) {
-		if (!netif_carrier_ok(axdev->netdev))
+		if (!netif_carrier_ok(axdev->netdev)) {
+			if (!axdev->link_up_ns)
+				axdev->link_up_ns = ktime_to_ns(ktime_get());
 			ax_set_carrier(axdev);
+		}
 	} else {
 		if (netif_carrier_ok(axdev->netdev)) {
 			netif_stop_queue(axdev->netdev);
@@ -1115,16 +1724,27 @@ static void __int_polling_work(struct work_struct *work)
 	}
 
 	mutex_unlock(&axdev->control);
+out:
+	schedule_delayed_work(&axdev->int_polling_work,
+			      msecs_to_jiffies(axdev->link_poll_ms));
+}
 
+static void ax_link_poll_start(struct ax_device *axdev)
+{
+	clear_bit(AX_INTR_UNRELIABLE, &axdev->flags);
+	axdev->link_sample_ns = 0;
+	axdev->link_poll_flow = 0;
+	axdev->link_poll_ms = INT_POLLING_MIN;
 	schedule_delayed_work(&axdev->int_polling_work,
-			      msecs_to_jiffies(INT_POLLING_TIMER));
+			      msecs_to_jiffies(INT_POLLING_MIN));
 }
-#endif
 static void ax_free_buffer(struct ax_device *axdev)
 {
 	int i;
 
-	for (i = 0; i < AX88179_MAX_RX; i++) {
+	axdev->buf_ready = false;
+
+	for (i = 0; i < ARRAY_SIZE(axdev->rx_list); i++) {
 		usb_free_urb(axdev->rx_list[i].urb);
 		axdev->rx_list[i].urb = NULL;
 
@@ -1133,7 +1753,7 @@ static void ax_free_buffer(struct ax_device *axdev)
 		axdev->rx_list[i].head = NULL;
 	}
 
-	for (i = 0; i < AX88179_MAX_TX; i++) {
+	for (i = 0; i < ARRAY_SIZE(axdev->tx_list); i++) {
 		usb_free_urb(axdev->tx_list[i].urb);
 		axdev->tx_list[i].urb = NULL;
 
@@ -1161,15 +1781,7 @@ static int ax_alloc_buffer(struct ax_device *axdev)
 
 	node = netdev->dev.parent ? dev_to_node(netdev->dev.parent) : -1;
 
-	spin_lock_init(&axdev->rx_lock);
-	spin_lock_init(&axdev->tx_lock);
-	INIT_LIST_HEAD(&axdev->tx_free);
-	INIT_LIST_HEAD(&axdev->rx_done);
-	for (i = 0; i < AX_TX_QUEUE_SIZE; i++)
-		skb_queue_head_init(&axdev->tx_queue[i]);
-	skb_queue_head_init(&axdev->rx_queue);
-
-	for (i = 0; i < AX88179_MAX_RX; i++) {
+	for (i = 0; i < axdev->rx_urbs; i++) {
 		buf = kmalloc_node(axdev->driver_info->buf_rx_size,
 				   GFP_KERNEL, node);
 		if (!buf)
@@ -1191,14 +1803,13 @@ static int ax_alloc_buffer(struct ax_device *axdev)
 			goto err1;
 		}
 
-		INIT_LIST_HEAD(&axdev->rx_list[i].list);
 		axdev->rx_list[i].context = axdev;
 		axdev->rx_list[i].urb = urb;
 		axdev->rx_list[i].buffer = buf;
 		axdev->rx_list[i].head = __rx_buf_align(buf);
 	}
 
-	for (i = 0; i < AX88179_MAX_TX; i++) {
+	for (i = 0; i < axdev->tx_urbs; i++) {
 		buf = kmalloc_node(AX88179_BUF_TX_SIZE, GFP_KERNEL, node);
 		if (!buf)
 			goto err1;
@@ -1218,14 +1829,11 @@ static int ax_alloc_buffer(struct ax_device *axdev)
 			goto err1;
 		}
 
-		INIT_LIST_HEAD(&axdev->tx_list[i].list);
 		axdev->tx_list[i].context = axdev;
 		axdev->tx_list[i].urb = urb;
 		axdev->tx_list[i].buffer = buf;
 		axdev->tx_list[i].head = __tx_buf_align(buf,
 							axdev->tx_align_len);
-
-		list_add_tail(&axdev->tx_list[i].list, &axdev->tx_free);
 	}
 
 	axdev->intr_urb = usb_alloc_urb(0, GFP_KERNEL);
@@ -1242,12 +1850,34 @@ static int ax_alloc_buffer(struct ax_device *axdev)
 			 INTBUFSIZE, ax_intr_callback, axdev,
 			 axdev->intr_interval);
 
+	axdev->buf_ready = true;
+
 	return 0;
 err1:
 	ax_free_buffer(axdev);
 	return -ENOMEM;
 }
 
+/* The rings are kept across ifdown/ifup, only their lists start over */
+static void ax_reset_buffer(struct ax_device *axdev)
+{
+	int i;
+
+	spin_lock_init(&axdev->rx_lock);
+	spin_lock_init(&axdev->tx_lock);
+	INIT_LIST_HEAD(&axdev->tx_free);
+	INIT_LIST_HEAD(&axdev->rx_done);
+	for (i = 0; i < AX_TX_QUEUE_SIZE; i++)
+		skb_queue_head_init(&axdev->tx_queue[i]);
+	skb_queue_head_init(&axdev->rx_queue);
+
+	for (i = 0; i < axdev->rx_urbs; i++)
+		INIT_LIST_HEAD(&axdev->rx_list[i].list);
+
+	for (i = 0; i < axdev->tx_urbs; i++)
+		list_add_tail(&axdev->tx_list[i].list, &axdev->tx_free);
+}
+
 static struct tx_desc *ax_get_tx_desc(struct ax_device *dev)
 {
 	struct tx_desc *desc = NULL;
@@ -1311,30 +1941,14 @@ static void ax_tx_bottom(struct ax_device *axdev)
 		}
 	} while (ret == 0);
 }
-#ifdef ENABLE_TX_TASKLET
-#if KERNEL_VERSION(5,10,0) > LINUX_VERSION_CODE
-static void ax_bottom_half(unsigned long t)
-{
-	struct ax_device *axdev = (struct ax_device *)t;
-#else
-static void ax_bottom_half(struct tasklet_struct *t)
-{
-	struct ax_device *axdev = from_tasklet(axdev, t, tx_tl);
-#endif
 
-#else
 static void ax_bottom_half(struct ax_device *axdev)
 {
-#endif
 	if (test_bit(AX_UNPLUG, &axdev->flags) ||
 	    !test_bit(AX_ENABLE, &axdev->flags) ||
 	    !netif_carrier_ok(axdev->netdev))
 		return;
-#ifdef ENABLE_TX_TASKLET
-	clear_bit(AX_SCHEDULE_TASKLET_TX, &axdev->flags);
-#else
-	clear_bit(AX_SCHEDULE_NAPI, &axdev->flags);
-#endif
+	clear_bit(AX_SCHEDULE_TX_NAPI, &axdev->flags);
 
 	ax_tx_bottom(axdev);
 }
@@ -1344,9 +1958,7 @@ static int ax_rx_bottom(struct ax_device *axdev, int budget)
 	unsigned long flags;
 	struct list_head *cursor, *next, rx_queue;
 	int ret = 0, work_done = 0;
-#ifndef ENABLE_RX_TASKLET
 	struct napi_struct *napi = &axdev->napi;
-#endif
 	struct net_device *netdev = axdev->netdev;
 	struct net_device_stats *stats = ax_get_stats(netdev);
 
@@ -1359,11 +1971,7 @@ static int ax_rx_bottom(struct ax_device *axdev, int budget)
 				break;
 
 			pkt_len = skb->len;
-#ifdef ENABLE_RX_TASKLET
-			netif_receive_skb(skb);
-#else
 			napi_gro_receive(napi, skb);
-#endif
 			work_done++;
 			stats->rx_packets++;
 			stats->rx_bytes += pkt_len;
@@ -1381,6 +1989,13 @@ static int ax_rx_bottom(struct ax_device *axdev, int budget)
 	list_for_each_safe(cursor, next, &rx_queue) {
 		struct rx_desc *desc;
 
+		if (tx_preempt && test_bit(AX_TX_TSTAMP, &axdev->flags))
+			break;
+
+		/* Keep small busy-poll budgets from parsing every URB */
+		if (work_done >= budget)
+			break;
+
 		list_del_init(cursor);
 
 		desc = list_entry(cursor, struct rx_desc, list);
@@ -1439,11 +2054,7 @@ int ax_submit_rx(struct ax_device *dev, struct rx_desc *desc, gfp_t mem_flags)
 
 		netif_err(dev, rx_err, dev->netdev,
 			  "Couldn't submit rx[%p], ret = %d\n", desc, ret);
-#ifdef ENABLE_RX_TASKLET
-		tasklet_schedule(&dev->rx_tl);
-#else
 		napi_schedule(&dev->napi);
-#endif
 	}
 
 	return ret;
@@ -1451,64 +2062,58 @@ int ax_submit_rx(struct ax_device *dev, struct rx_desc *desc, gfp_t mem_flags)
 
 static inline int __ax_poll(struct ax_device *axdev, int budget)
 {
-#ifndef ENABLE_RX_TASKLET
 	struct napi_struct *napi = &axdev->napi;
-#endif
 	int work_done;
 
 	work_done = ax_rx_bottom(axdev, budget);
-#ifndef ENABLE_TX_TASKLET
-	ax_bottom_half(axdev);
-#endif
+
+	/* Stay scheduled but let the TX NAPI send a PTP event frame first */
+	if (tx_preempt && test_and_clear_bit(AX_TX_TSTAMP, &axdev->flags))
+		return budget;
 
 	if (work_done < budget) {
-#ifndef ENABLE_RX_TASKLET
 #if KERNEL_VERSION(4, 10, 0) > LINUX_VERSION_CODE
 		napi_complete_done(napi, work_done);
 #else
 		if (!napi_complete_done(napi, work_done))
 			return work_done;
-#endif
 #endif
 		if (!list_empty(&axdev->rx_done))
-#ifdef ENABLE_RX_TASKLET
-			tasklet_schedule(&axdev->rx_tl);
-#else
-			napi_schedule(napi);
-#endif
-
-#ifndef ENABLE_TX_TASKLET
-		else if (ax_check_tx_queue_not_empty(axdev) >= 0 &&
-			 !list_empty(&axdev->tx_free))
 			napi_schedule(napi);
-#endif
 	}
 
 	return work_done;
 }
 
-#ifdef ENABLE_RX_TASKLET
-#if KERNEL_VERSION(5,10,0) > LINUX_VERSION_CODE
-static void ax_poll(unsigned long t)
-{
-	struct ax_device *axdev = (struct ax_device *)t;
-#else
-static void ax_poll(struct tasklet_struct *t)
-{
-	struct ax_device *axdev = from_tasklet(axdev, t, rx_tl);
-#endif
-	__ax_poll(axdev, 256);
-}
-
-#else
-
 static int ax_poll(struct napi_struct *napi, int budget)
 {
 	struct ax_device *axdev = container_of(napi, struct ax_device, napi);
 
 	return __ax_poll(axdev, budget);
 }
+
+static int ax_tx_poll(struct napi_struct *napi, int budget)
+{
+	struct ax_device *axdev = container_of(napi, struct ax_device, tx_napi);
+
+	ax_bottom_half(axdev);
+
+	/* netpoll only asks for TX completion, it must not complete */
+	if (!budget)
+		return 0;
+
+#if KERNEL_VERSION(4, 10, 0) > LINUX_VERSION_CODE
+	napi_complete_done(napi, 0);
+#else
+	if (!napi_complete_done(napi, 0))
+		return 0;
 #endif
+	if (ax_check_tx_queue_not_empty(axdev) >= 0 &&
+	    !list_empty(&axdev->tx_free))
+		napi_schedule(napi);
+
+	return 0;
+}
 
 static void ax_drop_queued_tx(struct ax_device *axdev)
 {
@@ -1573,6 +2178,8 @@ static netdev_tx_t ax_start_xmit(struct sk_buff *skb, struct net_device *netdev)
 	u32 index = ax_select_queue(netdev, skb, NULL);
 #endif
 	skb_tx_timestamp(skb);
+	if (skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP)
+		set_bit(AX_TX_TSTAMP, &axdev->flags);
 #ifdef ENABLE_QUEUE_PRIORITY
 	skb_queue_tail(&axdev->tx_queue[index], skb);
 #else
@@ -1580,19 +2187,11 @@ static netdev_tx_t ax_start_xmit(struct sk_buff *skb, struct net_device *netdev)
 #endif
 	if (!list_empty(&axdev->tx_free)) {
 		if (test_bit(AX_SELECTIVE_SUSPEND, &axdev->flags)) {
-#ifdef ENABLE_TX_TASKLET
-			set_bit(AX_SCHEDULE_TASKLET_TX, &axdev->flags);
-#else
-			set_bit(AX_SCHEDULE_NAPI, &axdev->flags);
-#endif
+			set_bit(AX_SCHEDULE_TX_NAPI, &axdev->flags);
 			schedule_delayed_work(&axdev->schedule, 0);
 		} else {
 			usb_mark_last_busy(axdev->udev);
-#ifdef ENABLE_TX_TASKLET
-			tasklet_schedule(&axdev->tx_tl);
-#else
-			napi_schedule(&axdev->napi);
-#endif
+			napi_schedule(&axdev->tx_napi);
 		}
 	} else if (ax_check_tx_queue_len(axdev)) {
 		netif_stop_queue(netdev);
@@ -1613,14 +2212,14 @@ static int ax_start_rx(struct ax_device *axdev)
 	int i, ret = 0;
 
 	INIT_LIST_HEAD(&axdev->rx_done);
-	for (i = 0; i < AX88179_MAX_RX; i++) {
+	for (i = 0; i < axdev->rx_urbs; i++) {
 		INIT_LIST_HEAD(&axdev->rx_list[i].list);
 		ret = ax_submit_rx(axdev, &axdev->rx_list[i], GFP_KERNEL);
 		if (ret)
 			break;
 	}
 
-	if (ret && ++i < AX88179_MAX_RX) {
+	if (ret && ++i < axdev->rx_urbs) {
 		struct list_head rx_queue;
 		unsigned long flags;
 
@@ -1632,7 +2231,7 @@ static int ax_start_rx(struct ax_device *axdev)
 
 			urb->actual_length = 0;
 			list_add_tail(&desc->list, &rx_queue);
-		} while (i < AX88179_MAX_RX);
+		} while (i < axdev->rx_urbs);
 
 		spin_lock_irqsave(&axdev->rx_lock, flags);
 		list_splice_tail(&rx_queue, &axdev->rx_done);
@@ -1646,7 +2245,7 @@ static int ax_stop_rx(struct ax_device *axdev)
 {
 	int i;
 
-	for (i = 0; i < AX88179_MAX_RX; i++)
+	for (i = 0; i < axdev->rx_urbs; i++)
 		usb_kill_urb(axdev->rx_list[i].urb);
 
 	while (!skb_queue_empty(&axdev->rx_queue))
@@ -1664,7 +2263,7 @@ static void ax_disable(struct ax_device *axdev)
 		return;
 	}
 
-	for (i = 0; i < AX88179_MAX_TX; i++)
+	for (i = 0; i < axdev->tx_urbs; i++)
 		usb_kill_urb(axdev->tx_list[i].urb);
 
 	ax_stop_rx(axdev);
@@ -1688,55 +2287,70 @@ ax88179_set_features(struct net_device *net, u32 features)
 #endif
 
 	if (changed & NETIF_F_IP_CSUM) {
-		ax_read_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &reg8, 0);
-		reg8 ^= AX_TXCOE_TCP | AX_TXCOE_UDP;
-		ax_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &reg8);
+		reg8 = AX_TXCOE_TCP | AX_TXCOE_UDP;
+		if (features & NETIF_F_IP_CSUM)
+			ax_update_reg(dev, AX_TXCOE_CTL, 1, 0, reg8);
+		else
+			ax_update_reg(dev, AX_TXCOE_CTL, 1, reg8, 0);
 	}
 
 	if (changed & NETIF_F_IPV6_CSUM) {
-		ax_read_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &reg8, 0);
-		reg8 ^= AX_TXCOE_TCPV6 | AX_TXCOE_UDPV6;
-		ax_write_cmd(dev, AX_ACCESS_MAC, AX_TXCOE_CTL, 1, 1, &reg8);
+		reg8 = AX_TXCOE_TCPV6 | AX_TXCOE_UDPV6;
+		if (features & NETIF_F_IPV6_CSUM)
+			ax_update_reg(dev, AX_TXCOE_CTL, 1, 0, reg8);
+		else
+			ax_update_reg(dev, AX_TXCOE_CTL, 1, reg8, 0);
 	}
 
 	if (changed & NETIF_F_RXCSUM) {
-		ax_read_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &reg8, 0);
-		reg8 ^= AX_RXCOE_IP | AX_RXCOE_TCP | AX_RXCOE_UDP |
-			AX_RXCOE_TCPV6 | AX_RXCOE_UDPV6;
-		ax_write_cmd(dev, AX_ACCESS_MAC, AX_RXCOE_CTL, 1, 1, &reg8);
+		reg8 = AX_RXCOE_IP | AX_RXCOE_TCP | AX_RXCOE_UDP |
+		       AX_RXCOE_TCPV6 | AX_RXCOE_UDPV6;
+		if (features & NETIF_F_RXCSUM)
+			ax_update_reg(dev, AX_RXCOE_CTL, 1, 0, reg8);
+		else
+			ax_update_reg(dev, AX_RXCOE_CTL, 1, reg8, 0);
 	}
 
+#if KERNEL_VERSION(3, 10, 0) <= LINUX_VERSION_CODE
+	if (changed & (NETIF_F_HW_VLAN_CTAG_FILTER | NETIF_F_HW_VLAN_CTAG_RX))
+		ax88179a_set_vlan_ctrl(dev, features);
+#endif
+
 	return 0;
 }
 #endif
 
+/* Time from the link-up event to netif_carrier_on(), in microseconds */
+static void ax_carrier_up_stat(struct ax_device *axdev)
+{
+	u64 delta = ktime_to_ns(ktime_get()) - axdev->link_up_ns;
+
+	axdev->carrier_up_last_us = div_u64(delta, NSEC_PER_USEC);
+	if (axdev->carrier_up_last_us > axdev->carrier_up_max_us)
+		axdev->carrier_up_max_us = axdev->carrier_up_last_us;
+	axdev->link_up_ns = 0;
+}
+
 static void ax_set_carrier(struct ax_device *axdev)
 {
 	struct net_device *netdev = axdev->netdev;
-#ifndef ENABLE_RX_TASKLET
 	struct napi_struct *napi = &axdev->napi;
-#endif
 
 	if (axdev->link) {
 #ifdef ENABLE_PTP_FUNC
 		axdev->driver_info->ptp_pps_ctrl(axdev, 1);
 #endif
 		if (!netif_carrier_ok(netdev)) {
+			if (!axdev->link_up_ns)
+				axdev->link_up_ns = ktime_to_ns(ktime_get());
 			if (axdev->driver_info->link_reset(axdev))
 				return;
 			netif_stop_queue(netdev);
-#ifdef ENABLE_RX_TASKLET
-			tasklet_disable(&axdev->rx_tl);
-#else
 			napi_disable(napi);
-#endif	
 			netif_carrier_on(netdev);
+			ax_carrier_up_stat(axdev);
 			ax_start_rx(axdev);
-#ifdef ENABLE_RX_TASKLET
-			tasklet_enable(&axdev->rx_tl);
-#else
 			napi_enable(napi);
-#endif
 			netif_wake_queue(netdev);
 		} else if (netif_queue_stopped(netdev) &&
 			   ax_check_tx_queue_len(axdev)) {
@@ -1746,25 +2360,14 @@ static void ax_set_carrier(struct ax_device *axdev)
 #ifdef ENABLE_PTP_FUNC
 		axdev->driver_info->ptp_pps_ctrl(axdev, 0);
 #endif
+		axdev->link_up_ns = 0;
 		if (netif_carrier_ok(netdev)) {
 			netif_carrier_off(netdev);
-#ifdef ENABLE_TX_TASKLET
-			tasklet_disable(&axdev->tx_tl);
-#endif
-#ifdef ENABLE_RX_TASKLET
-			tasklet_disable(&axdev->rx_tl);
-#else
+			napi_disable(&axdev->tx_napi);
 			napi_disable(napi);
-#endif			
 			ax_disable(axdev);
-#ifdef ENABLE_RX_TASKLET
-			tasklet_enable(&axdev->rx_tl);
-#else
 			napi_enable(napi);
-#endif	
-#ifdef ENABLE_TX_TASKLET
-			tasklet_enable(&axdev->tx_tl);
-#endif
+			napi_enable(&axdev->tx_napi);
 		}
 	}
 #ifdef ENABLE_AX88279
@@ -1801,6 +2404,8 @@ static inline void __ax_work_func(struct ax_device *axdev)
 
 	if (test_and_clear_bit(AX_LINK_CHG, &axdev->flags))
 		ax_set_carrier(axdev);
+	if (test_and_clear_bit(AX_RX_MODE_RETRY, &axdev->flags))
+		ax_rx_mode_retry(axdev);
 #ifdef ENABLE_DWC3_ENHANCE
 	if (test_and_clear_bit(AX_EN_RX, &axdev->flags)) {
 		u16 medium_mode;
@@ -1814,20 +2419,9 @@ static inline void __ax_work_func(struct ax_device *axdev)
 		}
 	}
 #endif
-#ifdef ENABLE_RX_TASKLET
-	if (test_and_clear_bit(AX_SCHEDULE_TASKLET_RX, &axdev->flags) &&
-	    netif_carrier_ok(axdev->netdev))
-		tasklet_schedule(&axdev->rx_tl);
-#else
-	if (test_and_clear_bit(AX_SCHEDULE_NAPI, &axdev->flags) &&
-	    netif_carrier_ok(axdev->netdev))
-		napi_schedule(&axdev->napi);
-#endif
-#ifdef ENABLE_TX_TASKLET
-	if (test_and_clear_bit(AX_SCHEDULE_TASKLET_TX, &axdev->flags) &&
+	if (test_and_clear_bit(AX_SCHEDULE_TX_NAPI, &axdev->flags) &&
 	    netif_carrier_ok(axdev->netdev))
-		tasklet_schedule(&axdev->tx_tl);
-#endif
+		napi_schedule(&axdev->tx_napi);
 
 	mutex_unlock(&axdev->control);
 
@@ -1874,23 +2468,53 @@ int ax_usb_command(struct ax_device *axdev, struct _ax_ioctl_command *info)
 	return 0;
 }
 
+#if KERNEL_VERSION(5, 12, 0) <= LINUX_VERSION_CODE
+static void ax_napi_set_affinity(struct ax_device *axdev)
+{
+	cpumask_var_t mask;
+
+	if (!napi_cpus)
+		return;
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return;
+
+	if (cpulist_parse(napi_cpus, mask) ||
+	    !cpumask_intersects(mask, cpu_online_mask)) {
+		netdev_warn(axdev->netdev, "Invalid napi_cpus \"%s\"\n",
+			    napi_cpus);
+	} else {
+		if (axdev->napi.thread)
+			set_cpus_allowed_ptr(axdev->napi.thread, mask);
+		if (axdev->tx_napi.thread)
+			set_cpus_allowed_ptr(axdev->tx_napi.thread, mask);
+	}
+
+	free_cpumask_var(mask);
+}
+#endif
+
 static int ax_open(struct net_device *netdev)
 {
 	struct ax_device *axdev = netdev_priv(netdev);
 	int res = 0;
 
-	res = ax_alloc_buffer(axdev);
-	if (res)
-		return res;
+	if (!axdev->buf_ready) {
+		res = ax_alloc_buffer(axdev);
+		if (res)
+			return res;
+	}
+	ax_reset_buffer(axdev);
 
 	res = usb_autopm_get_interface(axdev->intf);
 	if (res < 0)
-		goto out_free;
+		return res;
 
 	mutex_lock(&axdev->control);
 
 	set_bit(AX_ENABLE, &axdev->flags);
 
+	ax_hw_state_reset(axdev);
 	res = axdev->driver_info->hw_init(axdev);
 	if (res < 0)
 		goto out_unlock;
@@ -1903,22 +2527,19 @@ static int ax_open(struct net_device *netdev)
 			   "intr_urb submit failed: %d\n", res);
 		goto out_unlock;
 	}
-#ifdef ENABLE_INT_POLLING
-	schedule_delayed_work(&axdev->int_polling_work,
-			      msecs_to_jiffies(INT_POLLING_TIMER));
-#endif
-#ifdef ENABLE_RX_TASKLET
-	tasklet_enable(&axdev->rx_tl);
-#else
+	ax_link_poll_start(axdev);
 	napi_enable(&axdev->napi);
-#endif
-#ifdef ENABLE_TX_TASKLET
-	tasklet_enable(&axdev->tx_tl);
+	napi_enable(&axdev->tx_napi);
+#if KERNEL_VERSION(5, 12, 0) <= LINUX_VERSION_CODE
+	ax_napi_set_affinity(axdev);
 #endif
 
 	netif_carrier_off(netdev);
 	netif_start_queue(netdev);
 	mutex_unlock(&axdev->control);
+#ifdef ENABLE_PTP_FUNC
+	ax_ptp_pm_update(axdev);
+#endif
 	usb_autopm_put_interface(axdev->intf);
 
 	return 0;
@@ -1926,8 +2547,6 @@ static int ax_open(struct net_device *netdev)
 out_unlock:
 	mutex_unlock(&axdev->control);
 	usb_autopm_put_interface(axdev->intf);
-out_free:
-	ax_free_buffer(axdev);
 	return res;
 }
 
@@ -1939,20 +2558,12 @@ static int ax_close(struct net_device *netdev)
 	if (axdev->driver_info->stop)
 		axdev->driver_info->stop(axdev);
 
-#ifdef ENABLE_TX_TASKLET
-	tasklet_disable(&axdev->tx_tl);
-#endif
 	clear_bit(AX_ENABLE, &axdev->flags);
 	usb_kill_urb(axdev->intr_urb);
-#ifdef ENABLE_INT_POLLING
 	cancel_delayed_work_sync(&axdev->int_polling_work);
-#endif
 	cancel_delayed_work_sync(&axdev->schedule);
-#ifdef ENABLE_RX_TASKLET
-	tasklet_disable(&axdev->rx_tl);
-#else
+	napi_disable(&axdev->tx_napi);
 	napi_disable(&axdev->napi);
-#endif
 	netif_stop_queue(axdev->netdev);
 
 	ret = usb_autopm_get_interface(axdev->intf);
@@ -1966,34 +2577,84 @@ static int ax_close(struct net_device *netdev)
 	if (!ret)
 		usb_autopm_put_interface(axdev->intf);
 
-	ax_free_buffer(axdev);
+#ifdef ENABLE_PTP_FUNC
+	/* Let a down interface autosuspend even with hwtstamp configured */
+	ax_ptp_pm_update(axdev);
+#endif
 
 	return ret;
 }
 
+#if KERNEL_VERSION(5, 17, 0) <= LINUX_VERSION_CODE
+void ax_get_ringparam(struct net_device *netdev,
+		      struct ethtool_ringparam *ring,
+		      struct kernel_ethtool_ringparam *kernel_ring,
+		      struct netlink_ext_ack *extack)
+#else
+void ax_get_ringparam(struct net_device *netdev,
+		      struct ethtool_ringparam *ring)
+#endif
+{
+	struct ax_device *axdev = netdev_priv(netdev);
+
+	ring->rx_max_pending = ARRAY_SIZE(axdev->rx_list);
+	ring->tx_max_pending = ARRAY_SIZE(axdev->tx_list);
+	ring->rx_pending = axdev->rx_urbs;
+	ring->tx_pending = axdev->tx_urbs;
+}
+
+#if KERNEL_VERSION(5, 17, 0) <= LINUX_VERSION_CODE
+int ax_set_ringparam(struct net_device *netdev,
+		     struct ethtool_ringparam *ring,
+		     struct kernel_ethtool_ringparam *kernel_ring,
+		     struct netlink_ext_ack *extack)
+#else
+int ax_set_ringparam(struct net_device *netdev,
+		     struct ethtool_ringparam *ring)
+#endif
+{
+	struct ax_device *axdev = netdev_priv(netdev);
+
+	if (ring->rx_mini_pending || ring->rx_jumbo_pending ||
+	    !ring->rx_pending || ring->rx_pending > ARRAY_SIZE(axdev->rx_list) ||
+	    !ring->tx_pending || ring->tx_pending > ARRAY_SIZE(axdev->tx_list))
+		return -EINVAL;
+
+	if (ring->rx_pending == axdev->rx_urbs &&
+	    ring->tx_pending == axdev->tx_urbs)
+		return 0;
+
+	/* The rings are in use while up, they are rebuilt on the next ifup */
+	if (netif_running(netdev))
+		return -EBUSY;
+
+	ax_free_buffer(axdev);
+	axdev->rx_urbs = ring->rx_pending;
+	axdev->tx_urbs = ring->tx_pending;
+
+	return 0;
+}
+
 static int ax88179_change_mtu(struct net_device *net, int new_mtu)
 {
 	struct ax_device *axdev = netdev_priv(net);
-	u16 reg16;
 
 	if (new_mtu <= 0 || new_mtu > net->max_mtu)
 		return -EINVAL;
 
 	net->mtu = new_mtu;
+	ax_set_tx_qlen(axdev);
 
-	if (net->mtu > 1500) {
-		ax_read_cmd(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			    2, 2, &reg16, 1);
-		reg16 |= AX_MEDIUM_JUMBO_EN;
-		ax_write_cmd(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			     2, 2, &reg16);
-	} else {
-		ax_read_cmd(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			    2, 2, &reg16, 1);
-		reg16 &= ~AX_MEDIUM_JUMBO_EN;
-		ax_write_cmd(axdev, AX_ACCESS_MAC, AX_MEDIUM_STATUS_MODE,
-			     2, 2, &reg16);
-	}
+	/* link_reset applies the jumbo bit when the interface comes up */
+	if (!netif_running(net))
+		return 0;
+
+	if (net->mtu > 1500)
+		ax_update_reg(axdev, AX_MEDIUM_STATUS_MODE, 2,
+			      0, AX_MEDIUM_JUMBO_EN);
+	else
+		ax_update_reg(axdev, AX_MEDIUM_STATUS_MODE, 2,
+			      AX_MEDIUM_JUMBO_EN, 0);
 
 	return 0;
 }
@@ -2108,12 +2769,14 @@ static int ax_get_chip_feature(struct ax_device *axdev)
 static int ax_get_mac_address(struct ax_device *axdev)
 {
 	struct net_device *netdev = axdev->netdev;
+	u8 node_id[ETH_ALEN];
 
 	if (ax_read_cmd(axdev, AX_ACCESS_MAC, AX_NODE_ID, ETH_ALEN,
 			ETH_ALEN, netdev->dev_addr, 0) < 0) {
 		dev_err(&axdev->intf->dev, "Failed to read MAC address");
 		return -ENODEV;
 	}
+	memcpy(node_id, netdev->dev_addr, ETH_ALEN);
 
 	if (ax_check_ether_addr(axdev))
 		dev_warn(&axdev->intf->dev, "Found invalid MAC address value");
@@ -2123,6 +2786,10 @@ static int ax_get_mac_address(struct ax_device *axdev)
 
 	memcpy(netdev->perm_addr, netdev->dev_addr, ETH_ALEN);
 
+	/* The device already holds the address it reported */
+	if (ether_addr_equal(node_id, netdev->dev_addr))
+		return 0;
+
 	if (ax_write_cmd(axdev, AX_ACCESS_MAC, AX_NODE_ID, ETH_ALEN,
 			ETH_ALEN, netdev->dev_addr) < 0) {
 		dev_err(&axdev->intf->dev, "Failed to write MAC address");
@@ -2133,6 +2800,17 @@ static int ax_get_mac_address(struct ax_device *axdev)
 }
 
 
+static void ax_late_init_work(struct work_struct *work)
+{
+	struct ax_device *axdev = container_of(work, struct ax_device,
+					       late_init_work);
+
+	if (test_bit(AX_UNPLUG, &axdev->flags))
+		return;
+
+	axdev->driver_info->late_init(axdev);
+}
+
 static bool ax_can_wakeup(struct ax_device *axdev)
 {
 	struct usb_device *udev = axdev->udev;
@@ -2147,6 +2825,7 @@ static int ax_probe(struct usb_interface *intf, const struct usb_device_id *id)
 	const struct driver_info *info;
 	struct net_device *netdev;
 	struct ax_device *axdev;
+	ktime_t t0, t1, t2, t3, t4;
 	int ret;
 
 	if (udev->actconfig->desc.bConfigurationValue != 1) {
@@ -2181,22 +2860,25 @@ static int ax_probe(struct usb_interface *intf, const struct usb_device_id *id)
 	axdev->autodetach = false;
 #endif
 	mutex_init(&axdev->control);
+	ret = ax_alloc_cmd_res(axdev);
+	if (ret < 0) {
+		dev_err(&intf->dev, "Out of memory\n");
+		goto out;
+	}
 	INIT_DELAYED_WORK(&axdev->schedule, ax_work_func_t);
-#ifdef ENABLE_TX_TASKLET
-#if KERNEL_VERSION(5,10,0) > LINUX_VERSION_CODE
-	tasklet_init(&axdev->tx_tl, ax_bottom_half, (unsigned long) axdev);
-#else
-	tasklet_setup(&axdev->tx_tl, ax_bottom_half);
-#endif
-	tasklet_disable(&axdev->tx_tl);
-#endif
+	INIT_DELAYED_WORK(&axdev->int_polling_work, __int_polling_work);
+	INIT_WORK(&axdev->late_init_work, ax_late_init_work);
+	axdev->rx_urbs = AX88179_MAX_RX;
+	axdev->tx_urbs = AX88179_MAX_TX;
 
+	t0 = ktime_get();
 	ret = ax_get_chip_feature(axdev);
 	if (ret) {
 		dev_err(&intf->dev, "Failed to get Device feature\n");
 		goto out;
 	}
 
+	t1 = ktime_get();
 	ret = info->bind(axdev);
 	if (ret) {
 		dev_err(&intf->dev, "Device initialization failed\n");
@@ -2204,24 +2886,24 @@ static int ax_probe(struct usb_interface *intf, const struct usb_device_id *id)
 	}
 
 	usb_set_intfdata(intf, axdev);
-#ifdef ENABLE_RX_TASKLET
-#if KERNEL_VERSION(5,10,0) > LINUX_VERSION_CODE
-	tasklet_init(&axdev->rx_tl, ax_poll, (unsigned long) axdev);
-#else
-	tasklet_setup(&axdev->rx_tl, ax_poll);
-#endif
-	tasklet_disable(&axdev->rx_tl);
-#else
 #if KERNEL_VERSION(5, 19, 0) <= LINUX_VERSION_CODE
 	netif_napi_add_weight(netdev, &axdev->napi, ax_poll, AX88179_NAPI_WEIGHT);
 #else
 	netif_napi_add(netdev, &axdev->napi, ax_poll, AX88179_NAPI_WEIGHT);
 #endif
+#if KERNEL_VERSION(6, 1, 0) <= LINUX_VERSION_CODE
+	netif_napi_add_tx(netdev, &axdev->tx_napi, ax_tx_poll);
+#elif KERNEL_VERSION(4, 5, 0) <= LINUX_VERSION_CODE
+	netif_tx_napi_add(netdev, &axdev->tx_napi, ax_tx_poll, NAPI_POLL_WEIGHT);
+#else
+	netif_napi_add(netdev, &axdev->tx_napi, ax_tx_poll, NAPI_POLL_WEIGHT);
 #endif
+	t2 = ktime_get();
 	ret = ax_get_mac_address(axdev);
 	if (ret < 0)
 		goto out;
 
+	t3 = ktime_get();
 	SET_NETDEV_DEV(netdev, &intf->dev);
 	ret = register_netdev(netdev);
 	if (ret != 0) {
@@ -2229,24 +2911,34 @@ static int ax_probe(struct usb_interface *intf, const struct usb_device_id *id)
 			  "couldn't register the device\n");
 		goto out1;
 	}
+	t4 = ktime_get();
+	netdev_dbg(netdev, "probe: feature %lldus bind %lldus mac %lldus register %lldus\n",
+		   ktime_us_delta(t1, t0), ktime_us_delta(t2, t1),
+		   ktime_us_delta(t3, t2), ktime_us_delta(t4, t3));
+#if KERNEL_VERSION(5, 12, 0) <= LINUX_VERSION_CODE
+	if (napi_threaded) {
+#if KERNEL_VERSION(6, 17, 0) <= LINUX_VERSION_CODE
+		ret = dev_set_threaded(netdev, NETDEV_NAPI_THREADED_ENABLED);
+#else
+		ret = dev_set_threaded(netdev, true);
+#endif
+		if (ret < 0)
+			netif_warn(axdev, probe, netdev,
+				   "threaded NAPI unavailable: %d\n", ret);
+	}
+#endif
 
 	device_set_wakeup_enable(&udev->dev, ax_can_wakeup(axdev));
-#ifdef ENABLE_INT_POLLING
-	INIT_DELAYED_WORK(&axdev->int_polling_work, __int_polling_work);
-#endif
+	if (info->late_init)
+		schedule_work(&axdev->late_init_work);
 
 	return 0;
 out1:
-#ifdef ENABLE_RX_TASKLET
-	tasklet_kill(&axdev->rx_tl);
-#else
+	netif_napi_del(&axdev->tx_napi);
 	netif_napi_del(&axdev->napi);
-#endif
-#ifdef ENABLE_TX_TASKLET
-	tasklet_kill(&axdev->tx_tl);
-#endif
 	usb_set_intfdata(intf, NULL);
 out:
+	ax_free_cmd_res(axdev);
 	free_netdev(netdev);
 	return ret;
 }
@@ -2257,17 +2949,14 @@ static void ax_disconnect(struct usb_interface *intf)
 
 	usb_set_intfdata(intf, NULL);
 	if (axdev) {
+		cancel_work_sync(&axdev->late_init_work);
 		axdev->driver_info->unbind(axdev);
 		ax_set_unplug(axdev);
-#ifdef ENABLE_RX_TASKLET
-		tasklet_kill(&axdev->rx_tl);
-#else
+		netif_napi_del(&axdev->tx_napi);
 		netif_napi_del(&axdev->napi);
-#endif
-#ifdef ENABLE_TX_TASKLET
-		tasklet_kill(&axdev->tx_tl);
-#endif
 		unregister_netdev(axdev->netdev);
+		ax_free_buffer(axdev);
+		ax_free_cmd_res(axdev);
 		free_netdev(axdev->netdev);
 	}
 }
@@ -2285,20 +2974,12 @@ static int ax_pre_reset(struct usb_interface *intf)
 		return 0;
 
 	netif_stop_queue(netdev);
-#ifdef ENABLE_TX_TASKLET
-	tasklet_disable(&axdev->tx_tl);
-#endif
 	clear_bit(AX_ENABLE, &axdev->flags);
 	usb_kill_urb(axdev->intr_urb);
-#ifdef ENABLE_INT_POLLING
 	cancel_delayed_work_sync(&axdev->int_polling_work);
-#endif
 	cancel_delayed_work_sync(&axdev->schedule);
-#ifdef ENABLE_RX_TASKLET
-	tasklet_disable(&axdev->rx_tl);
-#else
+	napi_disable(&axdev->tx_napi);
 	napi_disable(&axdev->napi);
-#endif
 	return 0;
 }
 
@@ -2310,6 +2991,8 @@ static int ax_post_reset(struct usb_interface *intf)
 	if (!axdev)
 		return 0;
 
+	ax_hw_state_reset(axdev);
+
 	netdev = axdev->netdev;
 	if (!netif_running(netdev))
 		return 0;
@@ -2321,27 +3004,14 @@ static int ax_post_reset(struct usb_interface *intf)
 		mutex_unlock(&axdev->control);
 	}
 
-#ifdef ENABLE_RX_TASKLET
-	tasklet_enable(&axdev->rx_tl);
-#else
 	napi_enable(&axdev->napi);
-#endif
-#ifdef ENABLE_TX_TASKLET
-	tasklet_enable(&axdev->tx_tl);
-#endif
+	napi_enable(&axdev->tx_napi);
 	netif_wake_queue(netdev);
 	usb_submit_urb(axdev->intr_urb, GFP_KERNEL);
-#ifdef ENABLE_INT_POLLING
-	schedule_delayed_work(&axdev->int_polling_work,
-			      msecs_to_jiffies(INT_POLLING_TIMER));
-#endif
+	ax_link_poll_start(axdev);
 
 	if (!list_empty(&axdev->rx_done))
-#ifdef ENABLE_RX_TASKLET
-		tasklet_schedule(&axdev->rx_tl);
-#else
 		napi_schedule(&axdev->napi);
-#endif
 
 	return 0;
 }
@@ -2358,10 +3028,7 @@ static int ax_system_resume(struct ax_device *axdev)
 		axdev->driver_info->system_resume(axdev);
 		set_bit(AX_ENABLE, &axdev->flags);
 		usb_submit_urb(axdev->intr_urb, GFP_NOIO);
-#ifdef ENABLE_INT_POLLING
-		schedule_delayed_work(&axdev->int_polling_work,
-				      msecs_to_jiffies(INT_POLLING_TIMER));
-#endif
+		ax_link_poll_start(axdev);
 	}
 
 	return 0;
@@ -2370,15 +3037,12 @@ static int ax_system_resume(struct ax_device *axdev)
 static int ax_runtime_resume(struct ax_device *axdev)
 {
 	struct net_device *netdev = axdev->netdev;
+	int ret;
 
 	if (netif_running(netdev) && (netdev->flags & IFF_UP)) {
-#ifdef ENABLE_RX_TASKLET
-		tasklet_disable(&axdev->rx_tl);
-#else
 		struct napi_struct *napi = &axdev->napi;
 
 		napi_disable(napi);
-#endif
 		set_bit(AX_ENABLE, &axdev->flags);
 
 		if (netif_carrier_ok(netdev)) {
@@ -2391,24 +3055,32 @@ static int ax_runtime_resume(struct ax_device *axdev)
 			}
 		}
 
-		axdev->driver_info->runtime_resume(axdev);
+		ret = axdev->driver_info->runtime_resume(axdev);
+		if (ret < 0) {
+			/* Leave the data path to a full link reset */
+			netdev_warn(netdev, "runtime resume failed: %d\n", ret);
+			if (netif_carrier_ok(netdev)) {
+				netif_carrier_off(netdev);
+				if (axdev->driver_info->stop)
+					axdev->driver_info->stop(axdev);
+			}
+			set_bit(AX_LINK_CHG, &axdev->flags);
+			schedule_delayed_work(&axdev->schedule, 0);
+		}
+#ifdef ENABLE_PTP_FUNC
+		if (axdev->ptp_cfg)
+			axdev->ptp_cfg->resume_ns = ktime_to_ns(ktime_get());
+#endif
 
-#ifdef ENABLE_RX_TASKLET
-		tasklet_enable(&axdev->rx_tl);
-#else
 		napi_enable(napi);
-#endif	
 		clear_bit(AX_SELECTIVE_SUSPEND, &axdev->flags);
 		if (!list_empty(&axdev->rx_done)) {
 			local_bh_disable();
-#ifdef ENABLE_RX_TASKLET
-			tasklet_schedule(&axdev->rx_tl);
-#else
 			napi_schedule(&axdev->napi);
-#endif	
 			local_bh_enable();
 		}
 		usb_submit_urb(axdev->intr_urb, GFP_NOIO);
+		ax_link_poll_start(axdev);
 	} else {
 		clear_bit(AX_SELECTIVE_SUSPEND, &axdev->flags);
 	}
@@ -2426,37 +3098,20 @@ static int ax_system_suspend(struct ax_device *axdev)
 	
 
 	if (netif_running(netdev) && test_bit(AX_ENABLE, &axdev->flags)) {
-#ifndef ENABLE_RX_TASKLET
 		struct napi_struct *napi = &axdev->napi;
-#endif
 
 		clear_bit(AX_ENABLE, &axdev->flags);
 		usb_kill_urb(axdev->intr_urb);
-#ifdef ENABLE_TX_TASKLET
-		tasklet_disable(&axdev->tx_tl);
-#endif
-#ifdef ENABLE_INT_POLLING
+		napi_disable(&axdev->tx_napi);
 		cancel_delayed_work_sync(&axdev->int_polling_work);
-#endif
 
 		ax_disable(axdev);
 
 		axdev->driver_info->system_suspend(axdev);
-#ifdef ENABLE_RX_TASKLET
-		tasklet_disable(&axdev->rx_tl);
-#else
 		napi_disable(napi);
-#endif
 		cancel_delayed_work_sync(&axdev->schedule);
-#ifdef ENABLE_RX_TASKLET
-		tasklet_enable(&axdev->rx_tl);
-#else
 		napi_enable(napi);
-#endif
-		
-#ifdef ENABLE_TX_TASKLET
-		tasklet_enable(&axdev->tx_tl);
-#endif
+		napi_enable(&axdev->tx_napi);
 	}
 
 	return ret;
@@ -2471,25 +3126,15 @@ static int ax_runtime_suspend(struct ax_device *axdev)
 	if (netif_running(netdev) && test_bit(AX_ENABLE, &axdev->flags)) {
 		clear_bit(AX_ENABLE, &axdev->flags);
 		usb_kill_urb(axdev->intr_urb);
-#ifdef ENABLE_INT_POLLING
 		cancel_delayed_work_sync(&axdev->int_polling_work);
-#endif
 
 		if (netif_carrier_ok(netdev)) {
-#ifdef ENABLE_RX_TASKLET
-			tasklet_disable(&axdev->rx_tl);
-#else
 			struct napi_struct *napi = &axdev->napi;
 
 			napi_disable(napi);
-#endif
 			
 			ax_stop_rx(axdev);
-#ifdef ENABLE_RX_TASKLET
-			tasklet_enable(&axdev->rx_tl);
-#else
 			napi_enable(napi);
-#endif
 		}
 
 		axdev->driver_info->runtime_suspend(axdev);
@@ -2520,6 +3165,8 @@ static int ax_resume(struct usb_interface *intf)
 	struct ax_device *axdev = usb_get_intfdata(intf);
 	int ret;
 
+	ax_hw_state_reset(axdev);
+
 	mutex_lock(&axdev->control);
 
 	if (test_bit(AX_SELECTIVE_SUSPEND, &axdev->flags))
@@ -2573,6 +3220,10 @@ const struct net_device_ops ax88179a_netdev_ops = {
 	.ndo_set_mac_address	= ax88179_set_mac_addr,
 	.ndo_change_mtu		= ax88179_change_mtu,
 	.ndo_validate_addr	= eth_validate_addr,
+#if KERNEL_VERSION(3, 10, 0) <= LINUX_VERSION_CODE
+	.ndo_vlan_rx_add_vid	= ax88179a_vlan_rx_add_vid,
+	.ndo_vlan_rx_kill_vid	= ax88179a_vlan_rx_kill_vid,
+#endif
 };
 
 #define ASIX_USB_DEVICE(vend, prod, lo, hi, info) { \
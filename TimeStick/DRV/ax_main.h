@@ -33,6 +33,9 @@
 #include <linux/efi.h>
 #include <linux/crc32.h>
 #include <linux/time.h>
+#if KERNEL_VERSION(3, 11, 0) <= LINUX_VERSION_CODE
+#include <net/busy_poll.h>
+#endif
 #include "ax_ioctl.h"
 
 #define napi_alloc_skb(napi, length) netdev_alloc_skb_ip_align(netdev, length)
@@ -104,7 +107,10 @@ typedef int (*usb_write_function)(struct ax_device *axdev, u8 cmd, u16 value,
 #define AX_TX_HEADER_LEN	8
 #define AX_TX_TIMEOUT		(5 * HZ)
 #define AX_MCAST_FILTER_SIZE	8
+#define AX_RX_MODE_RETRY_MS	100
 #define AX_MAX_MCAST		64
+#define AX_CMD_BUF_SIZE		128
+#define AX_REG_SHADOW_SIZE	256
 #ifdef ENABLE_QUEUE_PRIORITY
 #define AX_TX_QUEUE_SIZE	2
 #else
@@ -358,10 +364,12 @@ enum ax_driver_flags {
 	AX_ENABLE,
 	AX_LINK_CHG,
 	AX_SELECTIVE_SUSPEND,
-	AX_SCHEDULE_NAPI,
+	AX_SCHEDULE_TX_NAPI,
 	AX_EN_RX,
-	AX_SCHEDULE_TASKLET_TX,
-	AX_SCHEDULE_TASKLET_RX,
+	AX_TX_TSTAMP,
+	AX_PTP_CAL,
+	AX_INTR_UNRELIABLE,
+	AX_RX_MODE_RETRY,
 };
 
 enum ax_chip_version {
@@ -431,31 +439,46 @@ struct ax_link_info {
 	   usb_speed	: 4;
 } __packed;
 
+struct ax_rx_mode {
+	struct urb *urb;
+	struct usb_ctrlrequest *req;
+	u8 *buf;
+	spinlock_t lock;
+	bool busy;
+	bool dirty;
+	bool use_filter;
+	u16 rxctl;
+	u8 m_filter[AX_MCAST_FILTER_SIZE];
+};
+
 struct ax_device {
 	unsigned long flags;
 	struct usb_device *udev;
 	struct usb_interface *intf;
 	struct net_device *netdev;
 	const struct driver_info *driver_info;
-#ifndef ENABLE_RX_TASKLET
 	struct napi_struct napi;
-#endif
+	struct napi_struct tx_napi;
 	struct urb *intr_urb;
 	struct tx_desc tx_list[32];
 	struct rx_desc rx_list[32];
+	u8 rx_urbs, tx_urbs;
+	bool buf_ready;
 	struct list_head rx_done, tx_free;
 	struct sk_buff_head tx_queue[AX_TX_QUEUE_SIZE];
 	struct sk_buff_head rx_queue;
 	spinlock_t rx_lock, tx_lock;
 	struct delayed_work schedule;
+	struct work_struct late_init_work;
 	struct mii_if_info mii;
 	struct mutex control;
-#ifdef ENABLE_TX_TASKLET
-	struct tasklet_struct tx_tl;
-#endif
-#ifdef ENABLE_RX_TASKLET
-	struct tasklet_struct rx_tl;
-#endif
+	struct mutex cmd_buf_lock;
+	void *cmd_buf;
+	struct ax_cmd_batch *cmd_batch;
+	struct ax_rx_mode rx_mode;
+	spinlock_t reg_shadow_lock;
+	DECLARE_BITMAP(reg_shadow_valid, AX_REG_SHADOW_SIZE);
+	u8 reg_shadow[AX_REG_SHADOW_SIZE];
 
 	int intr_interval;
 	u32 saved_wolopts;
@@ -468,6 +491,7 @@ struct ax_device {
 	u8 link;
 	u16 rxctl;
 	u8 m_filter[8];
+	DECLARE_BITMAP(active_vlans, VLAN_N_VID);
 	u32 tx_casecade_size;
 	u32 gso_max_size;
 	u8 fw_version[4];
@@ -500,26 +524,45 @@ struct ax_device {
 	u64 bulkout_error;
 	u64 bulkint_complete;
 	u64 bulkint_error;
+	u64 reg_shadow_hits;
+	u64 reg_shadow_misses;
+	u64 carrier_up_last_us;
+	u64 carrier_up_max_us;
+	u64 link_up_ns;
+	u64 link_detect_last_us;
+	u64 link_detect_max_us;
+	u64 link_polls;
 #ifdef ENABLE_QUEUE_PRIORITY
 	u64 ep5_count;
 	u64 ep3_count;
 #endif
+#ifdef ENABLE_PTP_FUNC
+	u64 ptp_ep4_gap_last;
+	u64 ptp_ep4_gap_max;
+	u64 ptp_ep4_empty;
+	u64 ptp_resume_ts_us;
+#endif
 #define CHIP_40PIN	0x03
 #define CHIP_32PIN	0x02
 	u8 chip_pin;
 #ifdef ENABLE_DWC3_ENHANCE
 	u8 intr_not_first_link_up;
 #endif
-#ifdef ENABLE_INT_POLLING
 #define INT_POLLING_TIMER	128	/* in milliseconds */
+#define INT_POLLING_MIN		16	/* in milliseconds */
 	struct delayed_work int_polling_work;
-#endif
+	u64 link_sample_ns;
+	unsigned long link_poll_rx;
+	u16 link_poll_ms;
+	u8 link_sampled;
+	u8 link_poll_flow;
 	unsigned autosuspend_is_supported:1;
 };
 
 struct driver_info {
 	int	(*bind)(struct ax_device *axdev);
 	void	(*unbind)(struct ax_device *axdev);
+	void	(*late_init)(struct ax_device *axdev);
 	int	(*hw_init)(struct ax_device *axdev);
 	int	(*stop)(struct ax_device *axdev);
 #ifdef ENABLE_QUEUE_PRIORITY
@@ -552,6 +595,25 @@ struct _async_cmd_handle {
 	u16 rxctl;
 } __packed;
 
+#define AX_CMD_BATCH_MAX	16
+#define AX_CMD_BATCH_DATA	8
+
+struct ax_cmd_batch_entry {
+	struct usb_ctrlrequest req;
+	u8 data[AX_CMD_BATCH_DATA];
+};
+
+struct ax_cmd_batch {
+	struct ax_device *axdev;
+	struct ax_cmd_batch_entry *entry;
+	struct urb *urb;
+	struct completion done;
+	int count;
+	int next;
+	int status;
+	int in_pm;
+};
+
 #define AX_INT_PPLS_LINK	(1 << 0)
 #define AX_INT_SPLS_LINK	(1 << 1)
 #define AX_INT_CABOFF_UNPLUG	(1 << 7)
@@ -645,6 +707,21 @@ void ax_get_pauseparam
 (struct net_device *netdev, struct ethtool_pauseparam *pause);
 int ax_set_pauseparam
 (struct net_device *netdev, struct ethtool_pauseparam *pause);
+#if KERNEL_VERSION(5, 17, 0) <= LINUX_VERSION_CODE
+void ax_get_ringparam(struct net_device *netdev,
+		      struct ethtool_ringparam *ring,
+		      struct kernel_ethtool_ringparam *kernel_ring,
+		      struct netlink_ext_ack *extack);
+int ax_set_ringparam(struct net_device *netdev,
+		     struct ethtool_ringparam *ring,
+		     struct kernel_ethtool_ringparam *kernel_ring,
+		     struct netlink_ext_ack *extack);
+#else
+void ax_get_ringparam(struct net_device *netdev,
+		      struct ethtool_ringparam *ring);
+int ax_set_ringparam(struct net_device *netdev,
+		     struct ethtool_ringparam *ring);
+#endif
 int ax_get_regs_len(struct net_device *netdev);
 void ax_get_regs
 (struct net_device *netdev, struct ethtool_regs *regs, void *buf);
@@ -666,6 +743,18 @@ int ax_write_cmd_nopm
 int ax_write_cmd_async
 (struct ax_device *axdev, u8 cmd, u16 value, u16 index, u16 size, void *data);
 
+int ax_update_reg
+(struct ax_device *axdev, u16 reg, u16 size, u16 clear, u16 set);
+
+void ax_set_rx_mode_async(struct ax_device *axdev, u16 rxctl,
+			  const u8 *m_filter);
+
+struct ax_cmd_batch *ax_cmd_batch_init(struct ax_device *axdev, int in_pm);
+void ax_cmd_batch_add
+(struct ax_cmd_batch *batch, u8 cmd, u16 value, u16 index, u16 size,
+const void *data);
+int ax_cmd_batch_run(struct ax_cmd_batch *batch);
+
 int ax_mmd_read(struct net_device *netdev, int dev_addr, int reg);
 void ax_mmd_write(struct net_device *netdev, int dev_addr, int reg, int val);
 
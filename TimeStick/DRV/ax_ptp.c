@@ -14,12 +14,32 @@
  * You should have received a copy of the GNU General Public License along with
  * this program. If not, see <https://www.gnu.org/licenses/>.
  ******************************************************************************/
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <net/ipv6.h>
 #include "ax_main.h"
 #include "ax_ptp.h"
 #include "ax88179a_772d.h"
 
 #define ptp_to_dev(ptp) container_of(ptp, struct ax_ptp_cfg, ptp_caps)
 
+static int ptp_tx_delay[AX_PTP_DELAY_SPEEDS] = { -1, -1, -1, -1 };
+module_param_array(ptp_tx_delay, int, NULL, 0644);
+MODULE_PARM_DESC(ptp_tx_delay,
+		 "PTP egress latency in ns for 10/100/1000/2500M (-1: default)");
+
+static int ptp_rx_delay[AX_PTP_DELAY_SPEEDS] = { -1, -1, -1, -1 };
+module_param_array(ptp_rx_delay, int, NULL, 0644);
+MODULE_PARM_DESC(ptp_rx_delay,
+		 "PTP ingress latency in ns for 10/100/1000/2500M (-1: default)");
+
+static const u32 ax88179a_ptp_tx_delay_def[AX_PTP_DELAY_SPEEDS] = {
+	0xFB7, 0x64, 0x6E, 0x6E
+};
+static const u32 ax88179a_ptp_rx_delay_def[AX_PTP_DELAY_SPEEDS] = {
+	0xAAC, 0x122, 0xE4, 0xE4
+};
+
 static void ax_reset_ptp_queue(struct ax_device *axdev)
 {
 	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
@@ -69,21 +89,34 @@ static int ax88179a_ptp_adjtime(struct ptp_clock_info *ptp, s64 delta)
 }
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6,2,0)
-static int
-ax88179a_ptp_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
+/*
+ * addend = base * (1 + scaled_ppm / (10^6 * 2^16)), rounded to nearest.
+ * 10^6 * 2^16 = 15625 * 2^22, divide by 15625 first so the product of the
+ * 32-bit base and a max_adj sized scaled_ppm stays within 64 bits.
+ */
+static u32 ax_ptp_calc_addend(long scaled_ppm)
+{
+	bool neg_adj = false;
+	u64 adjust_val;
+
+	if (scaled_ppm < 0) {
+		neg_adj = true;
+		scaled_ppm = -scaled_ppm;
+	}
+
+	adjust_val = mul_u64_u64_div_u64(AX_BASE_ADDEND, (u64)scaled_ppm, 15625);
+	adjust_val = (adjust_val + BIT_ULL(21)) >> 22;
+
+	if (neg_adj)
+		return (u32)(AX_BASE_ADDEND - adjust_val);
+
+	return (u32)(AX_BASE_ADDEND + adjust_val);
+}
 #else
-static int
-ax88179a_ptp_adjfreq(struct ptp_clock_info *ptp, s32 ppb)
-#endif
+static u32 ax_ptp_calc_addend(s32 ppb)
 {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,2,0)
-	long ppb = scaled_ppm_to_ppb(scaled_ppm);
-#endif
-	struct ax_ptp_cfg *ptp_cfg = ptp_to_dev(ptp);
-	struct ax_device *axdev = (struct ax_device *)ptp_cfg->axdev;
-	u32 new_addend_val;
+	int neg_adj = 0;
 	u64 adjust_val;
-	int neg_adj = 0, ret;
 
 	if (ppb < 0) {
 		neg_adj = 1;
@@ -92,23 +125,48 @@ ax88179a_ptp_adjfreq(struct ptp_clock_info *ptp, s32 ppb)
 
 	adjust_val = AX_BASE_ADDEND;
 	adjust_val *= ppb;
-	adjust_val = div_u64(adjust_val, NSEC_PER_SEC);
+	adjust_val = div_u64(adjust_val + NSEC_PER_SEC / 2, NSEC_PER_SEC);
 
 	if (neg_adj)
-		new_addend_val = (u32)(AX_BASE_ADDEND - adjust_val);
-	else
-		new_addend_val = (u32)(AX_BASE_ADDEND + adjust_val);
+		return (u32)(AX_BASE_ADDEND - adjust_val);
+
+	return (u32)(AX_BASE_ADDEND + adjust_val);
+}
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,2,0)
+static int
+ax88179a_ptp_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
+#else
+static int
+ax88179a_ptp_adjfreq(struct ptp_clock_info *ptp, s32 ppb)
+#endif
+{
+	struct ax_ptp_cfg *ptp_cfg = ptp_to_dev(ptp);
+	struct ax_device *axdev = (struct ax_device *)ptp_cfg->axdev;
+	u32 new_addend_val;
+	int ret;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,2,0)
+	new_addend_val = ax_ptp_calc_addend(scaled_ppm);
+#else
+	new_addend_val = ax_ptp_calc_addend(ppb);
+#endif
+	if (new_addend_val == ptp_cfg->addend)
+		return 0;
 
 	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_ADDEND, 0,
 			   AX_SET_ADDEND_SIZE, &new_addend_val);
 	if (ret < 0)
 		return ret;
 
+	ptp_cfg->addend = new_addend_val;
+
 	return 0;
 }
 
-static int ax88179a_ptp_gettime64
-(struct ptp_clock_info *ptp, struct timespec64 *ts)
+static int __ax88179a_ptp_gettime(struct ptp_clock_info *ptp,
+				  struct timespec64 *ts)
 {
 	struct ax_ptp_cfg *ptp_cfg = ptp_to_dev(ptp);
 	struct ax_device *axdev = (struct ax_device *)ptp_cfg->axdev;
@@ -130,6 +188,27 @@ static int ax88179a_ptp_gettime64
 	return 0;
 }
 
+static int ax88179a_ptp_gettime64
+(struct ptp_clock_info *ptp, struct timespec64 *ts)
+{
+	return __ax88179a_ptp_gettime(ptp, ts);
+}
+
+#if KERNEL_VERSION(5, 0, 0) <= LINUX_VERSION_CODE
+static int ax88179a_ptp_gettimex64(struct ptp_clock_info *ptp,
+				   struct timespec64 *ts,
+				   struct ptp_system_timestamp *sts)
+{
+	int ret;
+
+	ptp_read_system_prets(sts);
+	ret = __ax88179a_ptp_gettime(ptp, ts);
+	ptp_read_system_postts(sts);
+
+	return ret;
+}
+#endif
+
 static int ax88179a_ptp_settime64
 (struct ptp_clock_info *ptp, const struct timespec64 *ts)
 {
@@ -153,9 +232,122 @@ static int ax88179a_ptp_settime64
 	return 0;
 }
 
+static int ax88179a_ptp_set_pps_width(struct ax_device *axdev, u32 width)
+{
+	int ret;
+
+	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_ACTIVE_TIME, 0,
+			   AX_SET_ACTIVE_TIME_SIZE, &width);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+#ifdef ENABLE_AX88279
+static int ax88279_ptp_set_pps_width(struct ax_device *axdev, u32 width);
+#endif
+
+/*
+ * The PPS generator fires on every rollover of the seconds counter and
+ * holds the output active for pps_width ns, so only a 1 s period aligned
+ * to the second boundary can be produced. The pulse width is taken from
+ * the duty cycle when one is requested, otherwise the default width is
+ * used. A start time can only mean "from the next second on", so one
+ * further in the future is rejected.
+ */
+static int ax_ptp_perout(struct ax_ptp_cfg *ptp_cfg,
+			 struct ptp_perout_request *perout, int on)
+{
+	struct ax_device *axdev = (struct ax_device *)ptp_cfg->axdev;
+	u32 width = AX_PPS_ACTIVE_DEFAULT_TIME;
+	struct timespec64 now;
+	u64 period;
+	int ret;
+
+	if (perout->index >= AX_PTP_N_PEROUT)
+		return -EINVAL;
+
+#if KERNEL_VERSION(5, 9, 0) <= LINUX_VERSION_CODE
+	if (perout->flags & ~PTP_PEROUT_DUTY_CYCLE)
+		return -EOPNOTSUPP;
+#elif KERNEL_VERSION(5, 4, 0) <= LINUX_VERSION_CODE
+	if (perout->flags)
+		return -EOPNOTSUPP;
+#endif
+
+	if (on) {
+		period = perout->period.sec * NSEC_PER_SEC +
+			 perout->period.nsec;
+		if (period != AX_PTP_PEROUT_PERIOD || perout->start.nsec)
+			return -ERANGE;
+
+		ret = ptp_cfg->ptp_caps.gettime64(&ptp_cfg->ptp_caps, &now);
+		if (ret < 0)
+			return ret;
+		if (perout->start.sec > now.tv_sec + 1)
+			return -ERANGE;
+#if KERNEL_VERSION(5, 9, 0) <= LINUX_VERSION_CODE
+		if (perout->flags & PTP_PEROUT_DUTY_CYCLE) {
+			u64 on_time = perout->on.sec * NSEC_PER_SEC +
+				      perout->on.nsec;
+
+			if (!on_time || on_time >= period)
+				return -ERANGE;
+			width = (u32)on_time;
+		}
+#endif
+		if (width != ptp_cfg->pps_width) {
+#ifdef ENABLE_AX88279
+			if (axdev->chip_version == AX_VERSION_AX88279)
+				ret = ax88279_ptp_set_pps_width(axdev, width);
+			else
+#endif
+				ret = ax88179a_ptp_set_pps_width(axdev, width);
+			if (ret < 0)
+				return ret;
+			ptp_cfg->pps_width = width;
+		}
+	}
+
+	ptp_cfg->pps_enable = !!on;
+
+	/* Output stays off without link, ax_set_carrier re-applies it */
+	if (!axdev->link)
+		return 0;
+
+	return axdev->driver_info->ptp_pps_ctrl(axdev, ptp_cfg->pps_enable);
+}
+
 static int ax_ptp_enable(struct ptp_clock_info *ptp,
 			 struct ptp_clock_request *rq, int on)
 {
+	struct ax_ptp_cfg *ptp_cfg = ptp_to_dev(ptp);
+
+	switch (rq->type) {
+	case PTP_CLK_REQ_PEROUT:
+		return ax_ptp_perout(ptp_cfg, &rq->perout, on);
+	default:
+		break;
+	}
+
+	return -EOPNOTSUPP;
+}
+
+static int ax_ptp_verify(struct ptp_clock_info *ptp, unsigned int pin,
+			 enum ptp_pin_function func, unsigned int chan)
+{
+	switch (func) {
+	case PTP_PF_NONE:
+		return 0;
+	case PTP_PF_PEROUT:
+		if (pin == AX_PTP_PIN_PPS_OUT && chan < AX_PTP_N_PEROUT)
+			return 0;
+		break;
+	default:
+		break;
+	}
+
 	return -EOPNOTSUPP;
 }
 
@@ -175,23 +367,110 @@ static struct ptp_clock_info ax88179a_772d_ptp_clock = {
 #endif
 	.adjtime	= ax88179a_ptp_adjtime,
 	.gettime64	= ax88179a_ptp_gettime64,
+#if KERNEL_VERSION(5, 0, 0) <= LINUX_VERSION_CODE
+	.gettimex64	= ax88179a_ptp_gettimex64,
+#endif
 	.settime64	= ax88179a_ptp_settime64,
-	.n_per_out	= 0,
+	.n_per_out	= AX_PTP_N_PEROUT,
+#if KERNEL_VERSION(6, 15, 0) <= LINUX_VERSION_CODE
+	.supported_perout_flags = PTP_PEROUT_DUTY_CYCLE,
+#endif
 	.enable		= ax_ptp_enable,
-	.n_pins		= 0,
-	.verify		= NULL,
+	.n_pins		= AX_PTP_N_PINS,
+	.verify		= ax_ptp_verify,
 	.pin_config	= NULL,
 };
 
+static int ax_ptp_delay_index(struct ax_device *axdev)
+{
+	switch (axdev->link_info.eth_speed) {
+	case ETHER_LINK_10:
+		return 0;
+	case ETHER_LINK_100:
+		return 1;
+	case ETHER_LINK_2500:
+		return 3;
+	case ETHER_LINK_1000:
+	default:
+		return 2;
+	}
+}
+
+/*
+ * The latency for the current link speed is taken from the module parameter
+ * when set, else from the last loopback calibration, else from the chip
+ * default table.
+ */
+static void ax_ptp_get_delay(struct ax_device *axdev, u32 *tx_delay,
+			     u32 *rx_delay)
+{
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	int idx = ax_ptp_delay_index(axdev);
+
+	*tx_delay = 0;
+	*rx_delay = 0;
+	if (axdev->chip_version == AX_VERSION_AX88179A_772D) {
+		*tx_delay = ax88179a_ptp_tx_delay_def[idx];
+		*rx_delay = ax88179a_ptp_rx_delay_def[idx];
+	}
+
+	if (ptp_cfg->cal_tx_delay[idx] >= 0)
+		*tx_delay = ptp_cfg->cal_tx_delay[idx];
+	if (ptp_cfg->cal_rx_delay[idx] >= 0)
+		*rx_delay = ptp_cfg->cal_rx_delay[idx];
+
+	if (ptp_tx_delay[idx] >= 0)
+		*tx_delay = ptp_tx_delay[idx];
+	if (ptp_rx_delay[idx] >= 0)
+		*rx_delay = ptp_rx_delay[idx];
+}
+
+static int ax88179a_ptp_set_delay(struct ax_device *axdev, u32 tx_delay,
+				  u32 rx_delay)
+{
+	u8 ptp_delay[AX_SET_TX_PHY_DELAY_SIZE] = { 0 };
+	__le32 delay;
+	int ret;
+
+	delay = cpu_to_le32(tx_delay);
+	memcpy(ptp_delay, &delay, 4);
+	ptp_delay[4] = axdev->ptp_cfg->ptp_ctrl1;
+	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_TX_PHY_DELAY, 0,
+			   AX_SET_TX_PHY_DELAY_SIZE, ptp_delay);
+	if (ret < 0)
+		return ret;
+
+	delay = cpu_to_le32(rx_delay);
+	memcpy(ptp_delay, &delay, 4);
+	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_RX_PHY_DELAY, 0,
+			   AX_SET_RX_PHY_DELAY_SIZE, ptp_delay);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+#ifdef ENABLE_AX88279
+static int ax88279_ptp_set_delay(struct ax_device *axdev, u32 tx_delay,
+				 u32 rx_delay);
+#endif
+
+static int ax_ptp_set_delay(struct ax_device *axdev, u32 tx_delay,
+			    u32 rx_delay)
+{
+#ifdef ENABLE_AX88279
+	if (axdev->chip_version == AX_VERSION_AX88279)
+		return ax88279_ptp_set_delay(axdev, tx_delay, rx_delay);
+#endif
+	return ax88179a_ptp_set_delay(axdev, tx_delay, rx_delay);
+}
+
 int ax88179a_ptp_init(struct ax_device *axdev)
 {
-	struct ax_link_info *link_info = &axdev->link_info;
 	u32 new_addend_val = AX_BASE_ADDEND;
+	u32 tx_delay, rx_delay;
 	u8 reg8;
 	u8 ptpset;
-	u8 ptp_tx_delay[5] = { 0 };
-	u8 ptp_rx_delay[5] = { 0 };
-	u32 reg32;
 	u32 timeout = 0;
 	int ret;
 #ifdef ENABLE_PTP_FUNC
@@ -200,10 +479,20 @@ int ax88179a_ptp_init(struct ax_device *axdev)
 	if (axdev->sub_version < 3)
 		return 0;
 
+	/* Clock, queue and filter setup survive a link flap */
+	if (axdev->ptp_cfg->hw_ready) {
+		ax_ptp_get_delay(axdev, &tx_delay, &rx_delay);
+		return ax88179a_ptp_set_delay(axdev, tx_delay, rx_delay);
+	}
+
+	/* Keep the servo's frequency trim across re-initialisation */
+	if (axdev->ptp_cfg->addend)
+		new_addend_val = axdev->ptp_cfg->addend;
 	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_ADDEND, 0,
 			   AX_SET_ADDEND_SIZE, &new_addend_val);
 	if (ret < 0)
 		return ret;
+	axdev->ptp_cfg->addend = new_addend_val;
 
 	reg8 = AX_PTP_PERIOD;
 	ret = ax_write_cmd(axdev, AX_PTP_CMD, AX88179A_PTP_TIMER_PERIOD,
@@ -226,6 +515,8 @@ int ax88179a_ptp_init(struct ax_device *axdev)
 		return ret;
 	ptpset |= AX_PTP_CTRL_L3_EN | AX_PTP_CTRL_EN | AX_PTP_TX_PLUS_DELAY |
 		  AX_PTP_TX_FILTER_GENERAL_MSG | AX_PTP_RX_FILTER_GENERAL_MSG;
+	if (axdev->ptp_cfg->rx_filter == HWTSTAMP_FILTER_PTP_V2_L2_EVENT)
+		ptpset &= ~AX_PTP_CTRL_L3_EN;
 	ret = ax_write_cmd(axdev, AX_PTP_CMD, AX88179A_PTP_CTRL_1,
 			    0, 1, &ptpset);
 	if (ret < 0)
@@ -254,44 +545,13 @@ int ax88179a_ptp_init(struct ax_device *axdev)
 			break;
 	} while (reg8 != AX_PTP_MEM_SEG_0);
 
-	reg32 = AX_PPS_ACTIVE_DEFAULT_TIME;
-	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_ACTIVE_TIME, 0,
-			   AX_SET_ACTIVE_TIME_SIZE, &reg32);
+	ret = ax88179a_ptp_set_pps_width(axdev, axdev->ptp_cfg->pps_width);
 	if (ret < 0)
 		return ret;
 
-	switch (link_info->eth_speed) {
-	case ETHER_LINK_100:
-		ptp_tx_delay[0] = 0x64;
-		ptp_tx_delay[4] = ptpset;
-		ptp_rx_delay[0] = 0x22;
-		ptp_rx_delay[1] = 0x01;
-		ptp_rx_delay[4] = ptpset;
-		break;
-	case ETHER_LINK_10:
-		ptp_tx_delay[0] = 0xB7;
-		ptp_tx_delay[1] = 0x0F;
-		ptp_tx_delay[4] = ptpset;
-		ptp_rx_delay[0] = 0xAC;
-		ptp_rx_delay[1] = 0x0A;
-		ptp_rx_delay[4] = ptpset;
-		break;
-	case ETHER_LINK_1000:
-	default:
-		ptp_tx_delay[0] = 0x6E;
-		ptp_tx_delay[4] = ptpset;
-		ptp_rx_delay[0] = 0xE4;
-		ptp_rx_delay[4] = ptpset;
-		break;
-	}
-
-	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_TX_PHY_DELAY, 0,
-			   AX_SET_TX_PHY_DELAY_SIZE, ptp_tx_delay);
-	if (ret < 0)
-		return ret;
-
-	ret = ax_write_cmd(axdev, AX_PTP_OP, AX_SET_RX_PHY_DELAY, 0,
-			   AX_SET_RX_PHY_DELAY_SIZE, ptp_rx_delay);
+	axdev->ptp_cfg->ptp_ctrl1 = ptpset;
+	ax_ptp_get_delay(axdev, &tx_delay, &rx_delay);
+	ret = ax88179a_ptp_set_delay(axdev, tx_delay, rx_delay);
 	if (ret < 0)
 		return ret;
 
@@ -299,6 +559,8 @@ int ax88179a_ptp_init(struct ax_device *axdev)
 	axdev->netdev->hw_features &= ~(NETIF_F_SG | NETIF_F_TSO);
 	axdev->netdev->vlan_features &= ~(NETIF_F_SG | NETIF_F_TSO);
 
+	axdev->ptp_cfg->hw_ready = 1;
+
 	return 0;
 }
 
@@ -306,7 +568,10 @@ int ax88179a_ptp_pps_ctrl(struct ax_device *axdev, u8 enable)
 {
 	u32 reg32 = 0;
 	int ret;
-	
+
+	if (axdev->ptp_cfg && !axdev->ptp_cfg->pps_enable)
+		enable = 0;
+
 	ret = ax_read_cmd(axdev, AX88179A_PBUS_REG, 0x1894, 0x000F, 4, &reg32, 1);
 	if (ret < 0)
 		return ret;
@@ -328,6 +593,9 @@ int ax88279_ptp_pps_ctrl(struct ax_device *axdev, u8 enable)
 	u32 reg32 = 0;
 	int ret;
 
+	if (axdev->ptp_cfg && !axdev->ptp_cfg->pps_enable)
+		enable = 0;
+
 	ret = ax_read_cmd(axdev, AX_PBUS_A32, 0xF8C8, 0x000C, 4, &reg32, 1);
 	if (ret < 0)
 		return ret;
@@ -356,6 +624,10 @@ void ax88179a_ptp_remove(struct ax_device *axdev)
 	ax_write_cmd(axdev, AX_PTP_CMD, AX88179A_PTP_CTRL_1, 0, 1, &reg8);
 }
 
+#ifdef ENABLE_AX88279
+static void ax88279_free_ts(struct ax_device *axdev);
+#endif
+
 void ax_ptp_unregister(struct ax_device *axdev)
 {
 	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
@@ -366,16 +638,46 @@ void ax_ptp_unregister(struct ax_device *axdev)
 	if (ptp_cfg) {
 		if (ptp_cfg->ptp_clock)
 			ptp_clock_unregister(ptp_cfg->ptp_clock);
+		if (test_and_clear_bit(AX_PTP_PM_HOLD, &ptp_cfg->pm_hold))
+			usb_autopm_put_interface_no_suspend(axdev->intf);
+#ifdef ENABLE_AX88279
+		ax88279_stop_get_ts(axdev);
+		ax88279_free_ts(axdev);
+#endif
 	}
 }
 
-static u8 ax_find_ptp_item(struct ax_device *axdev, struct _ptp_header *ptp,
-			   struct sk_buff *skb)
+/*
+ * Selective suspend stops EP4 and drops the timestamp pipeline, so keep the
+ * device awake while TX hardware timestamping is enabled on a running
+ * interface. Called on hwtstamp changes, ifup and ifdown.
+ */
+void ax_ptp_pm_update(struct ax_device *axdev)
+{
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+
+	if (!ptp_cfg)
+		return;
+
+	/* The bit owns the reference, concurrent callers take or drop it once */
+	if (ptp_cfg->tx_type != HWTSTAMP_TX_OFF &&
+	    netif_running(axdev->netdev)) {
+		if (test_and_set_bit(AX_PTP_PM_HOLD, &ptp_cfg->pm_hold))
+			return;
+		if (usb_autopm_get_interface(axdev->intf) < 0)
+			clear_bit(AX_PTP_PM_HOLD, &ptp_cfg->pm_hold);
+	} else if (test_and_clear_bit(AX_PTP_PM_HOLD, &ptp_cfg->pm_hold)) {
+		usb_autopm_put_interface(axdev->intf);
+	}
+}
+
+static u8 ax_find_ptp_item(struct ax_device *axdev, struct sk_buff *skb)
 {
 	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
 	struct _ax_ptp_info *temp_ptp_info = ptp_cfg->tx_ptp_info;
+	struct ax_ptp_skb_cb *cb = AX_PTP_SKB_CB(skb);
 	u16 sequence_id;
-	u8 message_type = ptp->message_type;
+	u8 message_type = cb->msg_type;
 	int i, read_ptr;
 
 	read_ptr = ptp_cfg->ptp_head;
@@ -384,9 +686,9 @@ static u8 ax_find_ptp_item(struct ax_device *axdev, struct _ptp_header *ptp,
 #endif
 
 	if (axdev->chip_version == AX_VERSION_AX88179A_772D)
-		sequence_id = ntohs(ptp->sequence_id) & 0xFF;
+		sequence_id = cb->sequence_id & 0xFF;
 	else
-		sequence_id = ntohs(ptp->sequence_id) & 0xFFFF;
+		sequence_id = cb->sequence_id & 0xFFFF;
 
 	for (i = 0; i < ptp_cfg->num_items; i++) {
 		if ((temp_ptp_info[read_ptr].sequence_id == sequence_id) &&
@@ -407,8 +709,19 @@ static u8 ax_find_ptp_item(struct ax_device *axdev, struct _ptp_header *ptp,
 			time64 += timestamp_l & 0xFFFFFFFF;
 			memset(&shhwtstamps, 0, sizeof(shhwtstamps));
 			shhwtstamps.hwtstamp = ns_to_ktime(time64);
-			if (ptp->flags & 0x2 ||
-			    (ptp->message_type != 0 && ptp->message_type != 3))
+			if (unlikely(ptp_cfg->resume_ns)) {
+				axdev->ptp_resume_ts_us =
+					div_u64(ktime_to_ns(ktime_get()) -
+						ptp_cfg->resume_ns,
+						NSEC_PER_USEC);
+				ptp_cfg->resume_ns = 0;
+			}
+			if (unlikely(skb == ptp_cfg->cal_skb)) {
+				ptp_cfg->cal_tx_ts = time64;
+				complete(&ptp_cfg->cal_tx_done);
+			}
+			if (cb->flags & 0x2 ||
+			    (message_type != 0 && message_type != 3))
 				skb_tstamp_tx(skb, &shhwtstamps);
 #ifdef ENABLE_PTP_DEBUG
 			printk("%s - skb_tstamp_tx return", __func__);
@@ -423,70 +736,127 @@ static u8 ax_find_ptp_item(struct ax_device *axdev, struct _ptp_header *ptp,
 	return AX_PTP_QUEUE_SIZE;
 }
 
-static void ax_tx_check_timestamp(struct ax_device *axdev, struct sk_buff *skb)
+/*
+ * Several EP4 transfers can be in flight, so a frame's report may arrive
+ * in a later completion than the one being processed. Returns false while
+ * the skb is still waiting for it.
+ */
+static bool ax_tx_check_timestamp(struct ax_device *axdev, struct sk_buff *skb)
 {
-	if (skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP) {
-		struct _ptp_header ptp;
-		unsigned int ptp_msg_offset;
-		u16 tmp, tx_ethertype, vlan_id = 0;
-		u8 vlan_size = 0, ptp_item = AX_PTP_QUEUE_SIZE;
-
-		skb_copy_from_linear_data_offset(skb, AX_ETHTYPE_OFFSET,
-						 &tmp, 2);
-		tx_ethertype = ntohs(tmp);
-		if (tx_ethertype == ETH_P_8021Q) {
-			skb_copy_from_linear_data_offset(skb,
-							 AX_ETHTYPE_OFFSET + 2,
-							 &tmp, 2);
-			vlan_id = ntohs(tmp) & 0xFFF;
-			vlan_size = 4;
-			skb_copy_from_linear_data_offset(skb,
-							 AX_ETHTYPE_OFFSET + 4,
-							 &tmp, 2);
-			tx_ethertype = ntohs(tmp);
-			if (tx_ethertype == ETH_P_8021Q) {
-				vlan_size = 8;
-				skb_copy_from_linear_data_offset(skb,
-							 AX_ETHTYPE_OFFSET + 4,
-							 &tmp, 2);
-				tx_ethertype = ntohs(tmp);
-			}
-		}
-		ptp_msg_offset = vlan_size;
-		if (tx_ethertype == ETH_P_1588)
-			ptp_msg_offset += AX_TX_PTPHDR_OFFSET_L2;
-		else if (tx_ethertype == ETH_P_IP)
-			ptp_msg_offset += AX_TX_PTPHDR_OFFSET_L3_IP;
-		else if (tx_ethertype == ETH_P_IPV6)
-			ptp_msg_offset += AX_TX_PTPHDR_OFFSET_L3_IPV6;
-		else
-			return;
+	unsigned long expires;
 
-		skb_copy_from_linear_data_offset(skb, ptp_msg_offset,
-						 &ptp, PTP_HDR_SIZE);
+	if (ax_find_ptp_item(axdev, skb) != AX_PTP_QUEUE_SIZE)
+		return true;
 
-		ptp_item = ax_find_ptp_item(axdev, &ptp, skb);
-		if (ptp_item == AX_PTP_QUEUE_SIZE) {
-			dev_err(&axdev->intf->dev,
-				"Not found item from PTP queue");
-			return;
-		}
-	}
+	expires = AX_PTP_SKB_CB(skb)->queued +
+		  msecs_to_jiffies(AX_PTP_TX_TS_TIMEOUT_MS);
+	if (time_before(jiffies, expires))
+		return false;
+
+	dev_err(&axdev->intf->dev, "Not found item from PTP queue");
+	dev_kfree_skb_any(skb);
+	return true;
 }
 
-static void ax_tx_timestamp(struct ax_device *axdev)
+/*
+ * Locate the PTP header behind any VLAN tags, IPv4 options or IPv6
+ * extension headers and cache what the TX timestamp is matched on.
+ * Returns false for frames that carry no PTP message.
+ */
+bool ax_ptp_tx_parse(struct sk_buff *skb)
 {
-	struct sk_buff_head *tx_timestamp = &axdev->tx_timestamp;
+	struct ax_ptp_skb_cb *cb = AX_PTP_SKB_CB(skb);
+	struct _ptp_header _ptp, *ptp;
+	unsigned int offset = ETH_HLEN;
+	__be16 _proto, *protop, proto;
+	int vlan_depth = 0;
+
+	protop = skb_header_pointer(skb, AX_ETHTYPE_OFFSET,
+				    sizeof(_proto), &_proto);
+	if (!protop)
+		return false;
+	proto = *protop;
+
+	while (proto == htons(ETH_P_8021Q) || proto == htons(ETH_P_8021AD)) {
+		struct vlan_hdr _vhdr, *vhdr;
+
+		if (++vlan_depth > 2)
+			return false;
+		vhdr = skb_header_pointer(skb, offset, sizeof(_vhdr), &_vhdr);
+		if (!vhdr)
+			return false;
+		proto = vhdr->h_vlan_encapsulated_proto;
+		offset += VLAN_HLEN;
+	}
 
-	while (!skb_queue_empty(tx_timestamp)) {
-		struct sk_buff *skb;
+	switch (ntohs(proto)) {
+	case ETH_P_1588:
+		break;
+	case ETH_P_IP:
+	{
+		struct iphdr _iph, *iph;
 
-		skb = __skb_dequeue(tx_timestamp);
-		if (!skb)
-			return;
+		iph = skb_header_pointer(skb, offset, sizeof(_iph), &_iph);
+		if (!iph || iph->ihl < 5 || iph->protocol != IPPROTO_UDP ||
+		    (iph->frag_off & htons(IP_MF | IP_OFFSET)))
+			return false;
+		offset += (iph->ihl << 2) + sizeof(struct udphdr);
+		break;
+	}
+	case ETH_P_IPV6:
+	{
+		struct ipv6hdr _ip6h, *ip6h;
+		__be16 frag_off;
+		u8 nexthdr;
+		int hoff;
+
+		ip6h = skb_header_pointer(skb, offset, sizeof(_ip6h), &_ip6h);
+		if (!ip6h)
+			return false;
+		nexthdr = ip6h->nexthdr;
+		hoff = ipv6_skip_exthdr(skb, offset + sizeof(*ip6h), &nexthdr,
+					&frag_off);
+		if (hoff < 0 || nexthdr != IPPROTO_UDP || frag_off)
+			return false;
+		offset = hoff + sizeof(struct udphdr);
+		break;
+	}
+	default:
+		return false;
+	}
+
+	ptp = skb_header_pointer(skb, offset, PTP_HDR_SIZE, &_ptp);
+	if (!ptp)
+		return false;
+
+	cb->msg_type = ptp->message_type;
+	cb->sequence_id = ntohs(ptp->sequence_id);
+	cb->flags = ptp->flags;
+
+	return true;
+}
 
-		ax_tx_check_timestamp(axdev, skb);
+/*
+ * The TX path queues with skb_queue_tail(), so the list is protected by
+ * its own lock. ts_lock only guards the report ring.
+ */
+static void ax_tx_timestamp(struct ax_device *axdev)
+{
+	struct sk_buff_head *tx_timestamp = &axdev->tx_timestamp;
+	struct sk_buff_head pending;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	__skb_queue_head_init(&pending);
+	while ((skb = skb_dequeue(tx_timestamp)) != NULL) {
+		if (!ax_tx_check_timestamp(axdev, skb))
+			__skb_queue_tail(&pending, skb);
 	}
+
+	/* Unmatched frames are older than anything queued meanwhile */
+	spin_lock_irqsave(&tx_timestamp->lock, flags);
+	skb_queue_splice(&pending, tx_timestamp);
+	spin_unlock_irqrestore(&tx_timestamp->lock, flags);
 }
 
 static struct _ax_ptp_info *ax_ptp_info_transform(struct ax_device *axdev,
@@ -653,6 +1023,259 @@ void ax_rx_get_timestamp(struct sk_buff *skb, u64 *pkt_hdr)
 	shhwtstamps->hwtstamp = ns_to_ktime(time64);
 }
 
+#ifdef ENABLE_AX88279
+static int ax88279_ptp_rx_ctrl(struct ax_device *axdev, int rx_filter);
+#endif
+
+/*
+ * Map a hwtstamp rx_filter onto what the parsers can select and program
+ * it. Returns the filter actually applied, which may be wider than the
+ * one requested, or a negative error.
+ */
+int ax_ptp_set_rx_filter(struct ax_device *axdev, int rx_filter)
+{
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	int ret = 0;
+	u8 reg8;
+
+	switch (rx_filter) {
+	case HWTSTAMP_FILTER_NONE:
+		break;
+	case HWTSTAMP_FILTER_PTP_V1_L4_EVENT:
+	case HWTSTAMP_FILTER_PTP_V1_L4_SYNC:
+	case HWTSTAMP_FILTER_PTP_V1_L4_DELAY_REQ:
+		rx_filter = HWTSTAMP_FILTER_PTP_V1_L4_EVENT;
+		break;
+	case HWTSTAMP_FILTER_PTP_V2_L4_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_L4_SYNC:
+	case HWTSTAMP_FILTER_PTP_V2_L4_DELAY_REQ:
+		rx_filter = HWTSTAMP_FILTER_PTP_V2_L4_EVENT;
+		break;
+	case HWTSTAMP_FILTER_PTP_V2_L2_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_L2_SYNC:
+	case HWTSTAMP_FILTER_PTP_V2_L2_DELAY_REQ:
+		rx_filter = HWTSTAMP_FILTER_PTP_V2_L2_EVENT;
+		break;
+	case HWTSTAMP_FILTER_PTP_V2_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_SYNC:
+	case HWTSTAMP_FILTER_PTP_V2_DELAY_REQ:
+		rx_filter = HWTSTAMP_FILTER_PTP_V2_EVENT;
+		break;
+	default:
+		return -ERANGE;
+	}
+
+	/* The 88179A parser only selects between L2 only and L2 + L3/L4 */
+	if (axdev->chip_version == AX_VERSION_AX88179A_772D &&
+	    rx_filter != HWTSTAMP_FILTER_NONE &&
+	    rx_filter != HWTSTAMP_FILTER_PTP_V2_L2_EVENT)
+		rx_filter = HWTSTAMP_FILTER_PTP_V2_EVENT;
+
+	if (ptp_cfg->rx_filter == rx_filter)
+		return rx_filter;
+
+	switch (axdev->chip_version) {
+#ifdef ENABLE_AX88279
+	case AX_VERSION_AX88279:
+		ret = ax88279_ptp_rx_ctrl(axdev, rx_filter);
+		break;
+#endif
+	case AX_VERSION_AX88179A_772D:
+		ret = ax_read_cmd(axdev, AX_PTP_CMD, AX88179A_PTP_CTRL_1,
+				  0, 1, &reg8, 0);
+		if (ret < 0)
+			break;
+		if (rx_filter == HWTSTAMP_FILTER_PTP_V2_L2_EVENT)
+			reg8 &= ~AX_PTP_CTRL_L3_EN;
+		else
+			reg8 |= AX_PTP_CTRL_L3_EN;
+		ret = ax_write_cmd(axdev, AX_PTP_CMD, AX88179A_PTP_CTRL_1,
+				   0, 1, &reg8);
+		if (ret < 0)
+			break;
+		ptp_cfg->ptp_ctrl1 = reg8;
+		break;
+	default:
+		break;
+	}
+	if (ret < 0)
+		return ret;
+
+	/* Cache only what the hardware accepted, so a failed write is retried */
+	ptp_cfg->rx_filter = rx_filter;
+
+	return rx_filter;
+}
+
+void ax_ptp_cal_rx(struct ax_device *axdev, struct sk_buff *skb)
+{
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	struct _ptp_header *ptp;
+	struct ethhdr *eth;
+
+	if (!ptp_cfg || skb->len < ETH_HLEN + PTP_HDR_SIZE)
+		return;
+
+	eth = (struct ethhdr *)skb->data;
+	if (eth->h_proto != htons(ETH_P_1588))
+		return;
+
+	ptp = (struct _ptp_header *)(eth + 1);
+	if (ptp->message_type != 0 ||
+	    ntohs(ptp->sequence_id) != AX_PTP_CAL_SEQ_ID)
+		return;
+
+	ptp_cfg->cal_rx_ts = ktime_to_ns(skb_hwtstamps(skb)->hwtstamp);
+	complete(&ptp_cfg->cal_rx_done);
+}
+
+static struct sk_buff *ax_ptp_cal_alloc_skb(struct ax_device *axdev)
+{
+	struct net_device *netdev = axdev->netdev;
+	static const u8 ptp_dst[ETH_ALEN] = { 0x01, 0x1B, 0x19, 0, 0, 0 };
+	struct _ptp_header *ptp;
+	struct sk_buff *skb;
+	struct ethhdr *eth;
+
+	skb = netdev_alloc_skb(netdev, AX_PTP_CAL_FRAME_LEN);
+	if (!skb)
+		return NULL;
+
+	eth = (struct ethhdr *)skb_put(skb, AX_PTP_CAL_FRAME_LEN);
+	memset(eth, 0, AX_PTP_CAL_FRAME_LEN);
+	ether_addr_copy(eth->h_dest, ptp_dst);
+	ether_addr_copy(eth->h_source, netdev->dev_addr);
+	eth->h_proto = htons(ETH_P_1588);
+
+	ptp = (struct _ptp_header *)(eth + 1);
+	ptp->message_type = 0;
+	*((u8 *)ptp + 1) = AX_PTP_VERSION_2;
+	ptp->message_len = htons(PTP_HDR_SIZE);
+	ptp->flags = htons(AX_PTP_FLAG_TWO_STEP);
+	ptp->sequence_id = htons(AX_PTP_CAL_SEQ_ID);
+
+	skb_reset_mac_header(skb);
+	skb->dev = netdev;
+	skb->protocol = htons(ETH_P_1588);
+	skb_shinfo(skb)->tx_flags |= SKBTX_HW_TSTAMP;
+
+	return skb;
+}
+
+/*
+ * Loop a two-step Sync back through the PHY with compensation disabled and
+ * take the TX to RX timestamp difference as the sum of the egress and
+ * ingress latency. The split between the two directions cannot be observed
+ * from loopback, so it is assumed symmetric. The result is kept for the
+ * current link speed and re-applied by ptp_init on every link reset.
+ */
+int ax_ptp_delay_calibrate(struct ax_device *axdev, s32 *tx_delay,
+			   s32 *rx_delay)
+{
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	struct net_device *netdev = axdev->netdev;
+	int phy_id = axdev->mii.phy_id;
+	u32 applied_tx, applied_rx;
+	struct sk_buff *skb;
+	int rx_filter;
+	s64 delta;
+	int idx, ret;
+	u16 bmcr;
+
+	if (!ptp_cfg || !ptp_cfg->ptp_clock)
+		return -EOPNOTSUPP;
+
+	if (!netif_carrier_ok(netdev))
+		return -ENOLINK;
+
+	/* cal_skb and the completions are shared, one calibration at a time */
+	if (test_and_set_bit(AX_PTP_CAL, &axdev->flags))
+		return -EBUSY;
+
+	idx = ax_ptp_delay_index(axdev);
+
+	/* The calibration Sync is an L2 frame, keep the L2 parser on for it */
+	rx_filter = ptp_cfg->rx_filter;
+	switch (rx_filter) {
+	case HWTSTAMP_FILTER_NONE:
+	case HWTSTAMP_FILTER_PTP_V1_L4_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_L4_EVENT:
+		ret = ax_ptp_set_rx_filter(axdev, HWTSTAMP_FILTER_PTP_V2_EVENT);
+		if (ret < 0)
+			goto out;
+		break;
+	default:
+		break;
+	}
+
+	skb = ax_ptp_cal_alloc_skb(axdev);
+	if (!skb) {
+		ret = -ENOMEM;
+		goto filter;
+	}
+
+	ret = ax_read_cmd(axdev, AX_ACCESS_PHY, phy_id, MII_BMCR, 2, &bmcr, 1);
+	if (ret < 0) {
+		kfree_skb(skb);
+		goto filter;
+	}
+
+	ret = ax_ptp_set_delay(axdev, 0, 0);
+	if (ret < 0) {
+		kfree_skb(skb);
+		goto restore;
+	}
+
+	reinit_completion(&ptp_cfg->cal_tx_done);
+	reinit_completion(&ptp_cfg->cal_rx_done);
+	ptp_cfg->cal_tx_ts = 0;
+	ptp_cfg->cal_rx_ts = 0;
+	ptp_cfg->cal_skb = skb;
+
+	ax_mdio_write(netdev, phy_id, MII_BMCR, bmcr | BMCR_LOOPBACK);
+	msleep(AX_PTP_CAL_SETTLE_MS);
+
+	dev_queue_xmit(skb);
+
+	ret = 0;
+	if (!wait_for_completion_timeout(&ptp_cfg->cal_tx_done,
+				msecs_to_jiffies(AX_PTP_CAL_TIMEOUT_MS)) ||
+	    !wait_for_completion_timeout(&ptp_cfg->cal_rx_done,
+				msecs_to_jiffies(AX_PTP_CAL_TIMEOUT_MS)))
+		ret = -ETIMEDOUT;
+
+	ax_mdio_write(netdev, phy_id, MII_BMCR, bmcr);
+	ptp_cfg->cal_skb = NULL;
+
+	if (ret == 0) {
+		delta = (s64)(ptp_cfg->cal_rx_ts - ptp_cfg->cal_tx_ts);
+		if (delta <= 0 || delta > AX_PTP_CAL_MAX_DELTA) {
+			netdev_err(netdev, "PTP delay calibration out of range (%lld ns)\n",
+				   delta);
+			ret = -ERANGE;
+		} else {
+			ptp_cfg->cal_tx_delay[idx] = (s32)(delta / 2);
+			ptp_cfg->cal_rx_delay[idx] =
+				(s32)delta - ptp_cfg->cal_tx_delay[idx];
+		}
+	}
+
+restore:
+	ax_ptp_get_delay(axdev, &applied_tx, &applied_rx);
+	if (ax_ptp_set_delay(axdev, applied_tx, applied_rx) < 0)
+		netdev_err(netdev, "Failed to restore PTP delay\n");
+
+	*tx_delay = applied_tx;
+	*rx_delay = applied_rx;
+filter:
+	if (ax_ptp_set_rx_filter(axdev, rx_filter) < 0)
+		netdev_err(netdev, "Failed to restore PTP RX filter\n");
+out:
+	clear_bit(AX_PTP_CAL, &axdev->flags);
+
+	return ret;
+}
+
 #ifdef ENABLE_AX88279
 static int ax_ptp_pbus_write(struct ax_device *axdev, u16 offset, u16 len,
 			     void *data)
@@ -671,6 +1294,13 @@ static int ax_ptp_pbus_write(struct ax_device *axdev, u16 offset, u16 len,
 	return 0;
 }
 
+static void ax_ptp_pbus_batch(struct ax_cmd_batch *batch, u16 offset,
+			      u16 len, void *data)
+{
+	ax_cmd_batch_add(batch, AX_PBUS_A32, offset, AX_PTP_REG_BASE_ADDR_HI,
+			 len, data);
+}
+
 static int ax_ptp_clk_write(struct ax_device *axdev, u16 offset, u16 len,
 			    void *data)
 {
@@ -706,34 +1336,29 @@ static int ax_ptp_clk_read(struct ax_device *axdev, u16 offset, u16 len,
 	return 0;
 }
 
+static int ax88279_ptp_set_pps_width(struct ax_device *axdev, u32 width)
+{
+	return ax_ptp_pbus_write(axdev, AX_PTP_PPS_ACTIVE_TIME, 4, &width);
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6,2,0)
 static int ax88279_ptp_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
 #else
 static int ax88279_ptp_adjfreq(struct ptp_clock_info *ptp, s32 ppb)
 #endif
 {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,2,0)
-	long ppb = scaled_ppm_to_ppb(scaled_ppm);
-#endif
 	struct ax_ptp_cfg *ptp_cfg = ptp_to_dev(ptp);
 	struct ax_device *axdev = (struct ax_device *)ptp_cfg->axdev;
 	u32 new_addend_val;
-	u64 adjust_val;
-	int neg_adj = 0, ret;
-
-	if (ppb < 0) {
-		neg_adj = 1;
-		ppb = -ppb;
-	}
-
-	adjust_val = AX_BASE_ADDEND;
-	adjust_val *= ppb;
-	adjust_val = div_u64(adjust_val, NSEC_PER_SEC);
+	int ret;
 
-	if (neg_adj)
-		new_addend_val = (u32)(AX_BASE_ADDEND - adjust_val);
-	else
-		new_addend_val = (u32)(AX_BASE_ADDEND + adjust_val);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,2,0)
+	new_addend_val = ax_ptp_calc_addend(scaled_ppm);
+#else
+	new_addend_val = ax_ptp_calc_addend(ppb);
+#endif
+	if (new_addend_val == ptp_cfg->addend)
+		return 0;
 
 	ret = ax_ptp_pbus_write(axdev,
 			   AX_PTP_TIMER_ADDEND,
@@ -742,6 +1367,8 @@ static int ax88279_ptp_adjfreq(struct ptp_clock_info *ptp, s32 ppb)
 	if (ret < 0)
 		return ret;
 
+	ptp_cfg->addend = new_addend_val;
+
 	return 0;
 }
 
@@ -776,8 +1403,8 @@ static int ax88279_ptp_adjtime(struct ptp_clock_info *ptp, s64 delta)
 	return 0;
 }
 
-static int ax88279_ptp_gettime64(struct ptp_clock_info *ptp,
-				struct timespec64 *ts)
+static int __ax88279_ptp_gettime(struct ptp_clock_info *ptp,
+				 struct timespec64 *ts)
 {
 	struct ax_ptp_cfg *ptp_cfg = ptp_to_dev(ptp);
 	struct ax_device *axdev = (struct ax_device *)ptp_cfg->axdev;
@@ -798,6 +1425,27 @@ static int ax88279_ptp_gettime64(struct ptp_clock_info *ptp,
 	return 0;
 }
 
+static int ax88279_ptp_gettime64(struct ptp_clock_info *ptp,
+				struct timespec64 *ts)
+{
+	return __ax88279_ptp_gettime(ptp, ts);
+}
+
+#if KERNEL_VERSION(5, 0, 0) <= LINUX_VERSION_CODE
+static int ax88279_ptp_gettimex64(struct ptp_clock_info *ptp,
+				  struct timespec64 *ts,
+				  struct ptp_system_timestamp *sts)
+{
+	int ret;
+
+	ptp_read_system_prets(sts);
+	ret = __ax88279_ptp_gettime(ptp, ts);
+	ptp_read_system_postts(sts);
+
+	return ret;
+}
+#endif
+
 static int ax88279_ptp_settime64(struct ptp_clock_info *ptp,
 				const struct timespec64 *ts)
 {
@@ -836,62 +1484,65 @@ static struct ptp_clock_info ax88279_ptp_clock = {
 #endif
 	.adjtime	= ax88279_ptp_adjtime,
 	.gettime64	= ax88279_ptp_gettime64,
+#if KERNEL_VERSION(5, 0, 0) <= LINUX_VERSION_CODE
+	.gettimex64	= ax88279_ptp_gettimex64,
+#endif
 	.settime64	= ax88279_ptp_settime64,
-	.n_per_out	= 0,
+	.n_per_out	= AX_PTP_N_PEROUT,
+#if KERNEL_VERSION(6, 15, 0) <= LINUX_VERSION_CODE
+	.supported_perout_flags = PTP_PEROUT_DUTY_CYCLE,
+#endif
 	.enable		= ax_ptp_enable,
-	.n_pins		= 0,
-	.verify		= NULL,
+	.n_pins		= AX_PTP_N_PINS,
+	.verify		= ax_ptp_verify,
 	.pin_config	= NULL,
 };
 
-int ax88279_ptp_init(struct ax_device *axdev)
+static int ax88279_ptp_rx_ctrl(struct ax_device *axdev, int rx_filter)
 {
-	struct ax_link_info *link_info = &axdev->link_info;
 	u32 reg32;
-	u8 reg8;
-	int ret;
 
-	ax_reset_ptp_queue(axdev);
-
-#ifdef ENABLE_PTP_FUNC
-	axdev->driver_info->ptp_pps_ctrl(axdev, 1);
-#endif
+	switch (rx_filter) {
+	case HWTSTAMP_FILTER_NONE:
+		reg32 = 0;
+		break;
+	case HWTSTAMP_FILTER_PTP_V1_L4_EVENT:
+	case HWTSTAMP_FILTER_PTP_V2_L4_EVENT:
+		reg32 = AX_PTP_RX_CTRL0_L4;
+		break;
+	case HWTSTAMP_FILTER_PTP_V2_L2_EVENT:
+		reg32 = AX_PTP_RX_CTRL0_L2;
+		break;
+	default:
+		reg32 = AX_PTP_RX_CTRL0_DEFAULT;
+		break;
+	}
 
-	reg32 = (AX_PTP_MEM_SEG_SIZE_279_5 << 24) |
-		(AX_PTP_MEM_START_ADDR << 8) | AX_PTP_PTP_CPU_EN;
-	ret = ax_ptp_pbus_write(axdev, AX_PTP_TX_MEM_SETTING, 4, &reg32);
-	if (ret < 0)
-		return ret;
+	if (axdev->link_info.eth_speed == ETHER_LINK_2500)
+		reg32 |= AX_PTP_RXC0_XGMII_EN;
 
-	reg32 = AX_PPS_ACTIVE_DEFAULT_TIME;
-	ret = ax_ptp_pbus_write(axdev, AX_PTP_PPS_ACTIVE_TIME, 4, &reg32);
-	if (ret < 0)
-		return ret;
+	return ax_ptp_pbus_write(axdev, AX_PTP_RX_CTRL0, 4, &reg32);
+}
 
-	reg32 = AX_PTP_LCK_CTRL0_EN | AX_PTP_LCK_CTRL0_80B_NS_EN |
-		AX_PTP_LCK_CTRL0_80B_S_EN | AX_PTP_LCK_CTRL0_48B_EN |
-		AX_PTP_LCK_CTRL0_PPS_EN | AX_PTP_LCK_CTRL0_TX_DEL_VEC;
-	ret = ax_ptp_pbus_write(axdev, AX_PTP_LCK_CTRL0, 4, &reg32);
-	if (ret < 0)
-		return ret;
+static int ax88279_ptp_set_delay(struct ax_device *axdev, u32 tx_delay,
+				 u32 rx_delay)
+{
+	int ret;
 
-	reg32 = AX_BASE_ADDEND;
-	ret = ax_ptp_pbus_write(axdev, AX_PTP_TIMER_ADDEND, 4, &reg32);
+	ret = ax_ptp_pbus_write(axdev, AX_PTP_TX_DELAY, 4, &tx_delay);
 	if (ret < 0)
 		return ret;
 
-	reg32 = AX_PTP_PERIOD;
-	ret = ax_ptp_pbus_write(axdev, AX_PTP_TIMER_PERIOD, 4, &reg32);
-	if (ret < 0)
-		return ret;
+	return ax_ptp_pbus_write(axdev, AX_PTP_RX_DELAY, 4, &rx_delay);
+}
 
-	ret = ax_read_cmd(axdev, AX_ACCESS_MAC, AX_MAC_BFM_CTRL, 1, 1, &reg8, 0);
-	if (ret < 0)
-		return ret;
-	reg8 |= AX_CS_TRAIL_UDPV4_EN | AX_CS_TRAIL_UDPV6_EN;
-	ret = ax_write_cmd(axdev, AX_ACCESS_MAC, AX_MAC_BFM_CTRL, 1, 1, &reg8);
-	if (ret < 0)
-		return ret;
+/* PTP state that depends on the link speed, rewritten on every link-up */
+static int ax88279_ptp_speed_setting(struct ax_device *axdev)
+{
+	struct ax_link_info *link_info = &axdev->link_info;
+	u32 tx_delay, rx_delay;
+	u32 reg32;
+	int ret;
 
 	switch (link_info->eth_speed) {
 	case ETHER_LINK_100:
@@ -903,8 +1554,7 @@ int ax88279_ptp_init(struct ax_device *axdev)
 		if (ret < 0)
 			return ret;
 
-		reg32 = AX_PTP_RX_CTRL0_DEFAULT;
-		ret = ax_ptp_pbus_write(axdev, AX_PTP_RX_CTRL0, 4, &reg32);
+		ret = ax88279_ptp_rx_ctrl(axdev, axdev->ptp_cfg->rx_filter);
 		if (ret < 0)
 			return ret;
 
@@ -923,8 +1573,7 @@ int ax88279_ptp_init(struct ax_device *axdev)
 		if (ret < 0)
 			return ret;
 
-		reg32 = AX_PTP_RX_CTRL0_DEFAULT;
-		ret = ax_ptp_pbus_write(axdev, AX_PTP_RX_CTRL0, 4, &reg32);
+		ret = ax88279_ptp_rx_ctrl(axdev, axdev->ptp_cfg->rx_filter);
 		if (ret < 0)
 			return ret;
 
@@ -935,8 +1584,7 @@ int ax88279_ptp_init(struct ax_device *axdev)
 			return ret;
 		break;
 	case ETHER_LINK_2500:
-		reg32 = AX_PTP_RX_CTRL0_DEFAULT | AX_PTP_RXC0_XGMII_EN;
-		ret = ax_ptp_pbus_write(axdev, AX_PTP_RX_CTRL0, 4, &reg32);
+		ret = ax88279_ptp_rx_ctrl(axdev, axdev->ptp_cfg->rx_filter);
 		if (ret < 0)
 			return ret;
 
@@ -950,13 +1598,64 @@ int ax88279_ptp_init(struct ax_device *axdev)
 		break;
 	}
 
-	reg32 = 0;
-	ret = ax_ptp_pbus_write(axdev, AX_PTP_TX_DELAY, 4, &reg32);
+	ax_ptp_get_delay(axdev, &tx_delay, &rx_delay);
+	ret = ax88279_ptp_set_delay(axdev, tx_delay, rx_delay);
 	if (ret < 0)
 		return ret;
 
-	reg32 = 0;
-	ret = ax_ptp_pbus_write(axdev, AX_PTP_RX_DELAY, 4, &reg32);
+	return 0;
+}
+
+int ax88279_ptp_init(struct ax_device *axdev)
+{
+	struct ax_cmd_batch *batch;
+	u32 reg32;
+	u8 reg8;
+	int ret;
+
+	ax_reset_ptp_queue(axdev);
+
+	/* Clock, queue and TOD setup survive a link flap */
+	if (axdev->ptp_cfg->hw_ready)
+		return ax88279_ptp_speed_setting(axdev);
+
+#ifdef ENABLE_PTP_FUNC
+	axdev->driver_info->ptp_pps_ctrl(axdev, 1);
+#endif
+
+	batch = ax_cmd_batch_init(axdev, 0);
+
+	reg32 = (AX_PTP_MEM_SEG_SIZE_279_5 << 24) |
+		(AX_PTP_MEM_START_ADDR << 8) | AX_PTP_PTP_CPU_EN;
+	ax_ptp_pbus_batch(batch, AX_PTP_TX_MEM_SETTING, 4, &reg32);
+
+	ax_ptp_pbus_batch(batch, AX_PTP_PPS_ACTIVE_TIME, 4,
+			  &axdev->ptp_cfg->pps_width);
+
+	reg32 = AX_PTP_LCK_CTRL0_EN | AX_PTP_LCK_CTRL0_80B_NS_EN |
+		AX_PTP_LCK_CTRL0_80B_S_EN | AX_PTP_LCK_CTRL0_48B_EN |
+		AX_PTP_LCK_CTRL0_PPS_EN | AX_PTP_LCK_CTRL0_TX_DEL_VEC;
+	ax_ptp_pbus_batch(batch, AX_PTP_LCK_CTRL0, 4, &reg32);
+
+	/* Keep the servo's frequency trim across re-initialisation */
+	if (!axdev->ptp_cfg->addend)
+		axdev->ptp_cfg->addend = AX_BASE_ADDEND;
+	ax_ptp_pbus_batch(batch, AX_PTP_TIMER_ADDEND, 4,
+			  &axdev->ptp_cfg->addend);
+
+	reg32 = AX_PTP_PERIOD;
+	ax_ptp_pbus_batch(batch, AX_PTP_TIMER_PERIOD, 4, &reg32);
+
+	ret = ax_cmd_batch_run(batch);
+	if (ret < 0)
+		return ret;
+
+	ret = ax_update_reg(axdev, AX_MAC_BFM_CTRL, 1, 0,
+			    AX_CS_TRAIL_UDPV4_EN | AX_CS_TRAIL_UDPV6_EN);
+	if (ret < 0)
+		return ret;
+
+	ret = ax88279_ptp_speed_setting(axdev);
 	if (ret < 0)
 		return ret;
 
@@ -966,22 +1665,26 @@ int ax88279_ptp_init(struct ax_device *axdev)
 	if (ret < 0)
 		return ret;
 
+	batch = ax_cmd_batch_init(axdev, 0);
+
 	reg32 = 0;
-	ret = ax_write_cmd(axdev, AX_PBUS_A32, AX_MAC_CLK_CTRL,
-			   AX_PBUS_REG_BASE_ADDR_HI, 4, &reg32);
-	if (ret < 0)
-		return ret;
+	ax_cmd_batch_add(batch, AX_PBUS_A32, AX_MAC_CLK_CTRL,
+			 AX_PBUS_REG_BASE_ADDR_HI, 4, &reg32);
 
 	reg32 = (0 << AX_DIVIDE_PTP_CLK_SHIFT) |
 		(1 << AX_DIVIDE_AES_CLK_SHIFT) |
 		AX_PTP_CLK_EN | AX_AES_CLK_EN |
 		AX_PTP_CLK_SELECT_DIVIDE | AX_AES_CLK_SELECT_DIVIDE |
 		AX_XGMAC_TX_CLK_EN | AX_XGMAC_RX_CLK_EN;
-	ret = ax_write_cmd(axdev, AX_PBUS_A32, AX_MAC_CLK_CTRL,
-			   AX_PBUS_REG_BASE_ADDR_HI, 4, &reg32);
+	ax_cmd_batch_add(batch, AX_PBUS_A32, AX_MAC_CLK_CTRL,
+			 AX_PBUS_REG_BASE_ADDR_HI, 4, &reg32);
+
+	ret = ax_cmd_batch_run(batch);
 	if (ret < 0)
 		return ret;
 
+	axdev->ptp_cfg->hw_ready = 1;
+
 	return 0;
 }
 
@@ -996,45 +1699,61 @@ void ax88279_ptp_remove(struct ax_device *axdev)
 	ax_ptp_pbus_write(axdev, AX_PTP_TX_CTRL0, 4, &reg32);
 }
 
-static int ax88279_submit_ts(struct ax_device *axdev);
+static int ax88279_submit_ts(struct ax_device *axdev,
+			     struct ax_ptp_ep4 *ep4, gfp_t mem_flags);
 static void ax88279_read_ts_callback(struct urb *urb)
 {
-	struct net_device *netdev;
+	struct ax_ptp_ep4 *ep4 = urb->context;
 	struct ax_device *axdev;
 	struct ax_ptp_cfg *ptp_cfg;
 	struct _ax_ptp_info *temp_ptp_info;
+	unsigned long flags;
+	u64 start, gap;
 	int i, index;
 
-	axdev = urb->context;
-	if (!axdev)
+	if (!ep4 || !ep4->axdev)
 		return;
 
+	axdev = ep4->axdev;
+	ptp_cfg = axdev->ptp_cfg;
+	start = ktime_get_ns();
+
+	if (atomic_dec_and_test(&ptp_cfg->ep4_inflight) && urb->status == 0)
+		axdev->ptp_ep4_empty++;
+
 	if (test_bit(AX_UNPLUG, &axdev->flags) ||
 	    !test_bit(AX_ENABLE, &axdev->flags))
 		return;
 
-	netdev = axdev->netdev;
-	if (!netif_carrier_ok(netdev))
+	switch (urb->status) {
+	case 0:
+		break;
+	case -ECONNRESET:
+	case -ENOENT:
+	case -ESHUTDOWN:
 		return;
-
-	usb_mark_last_busy(axdev->udev);
-
-	ptp_cfg = axdev->ptp_cfg;
-
-	if (urb->status < 0) {
+	default:
 		dev_err(&axdev->intf->dev,
 			"failed get ts (%d)", urb->status);
 		goto out;
 	}
+
+	if (!netif_carrier_ok(axdev->netdev))
+		goto out;
+
+	usb_mark_last_busy(axdev->udev);
 #ifdef ENABLE_PTP_DEBUG
-	printk("EP4 Valid: 0x%x", ptp_cfg->ep4_buf[AX_PTP_EP4_SIZE - 1]);
+	printk("EP4 Valid: 0x%x", ep4->buf[AX_PTP_EP4_SIZE - 1]);
 #endif
-	index = (ptp_cfg->ep4_buf[AX_PTP_EP4_SIZE - 1] & AX_TS_SEG_1) ?
+	index = (ep4->buf[AX_PTP_EP4_SIZE - 1] & AX_TS_SEG_1) ?
 		0 : (AX_PTP_INFO_SIZE * AX_PTP_HW_QUEUE_SIZE);
 #ifdef ENABLE_PTP_DEBUG
 	printk("index: %d", index);
 #endif
-	temp_ptp_info = (struct _ax_ptp_info *)&ptp_cfg->ep4_buf[index];
+	temp_ptp_info = (struct _ax_ptp_info *)&ep4->buf[index];
+
+	/* Serialise the report ring against the other EP4 completions */
+	spin_lock_irqsave(&ptp_cfg->ts_lock, flags);
 	for (i = 0; i < AX_PTP_HW_QUEUE_SIZE; i++) {
 		if (temp_ptp_info[i].status) {
 			ptp_cfg->tx_ptp_info[ptp_cfg->ptp_tail++] =
@@ -1057,46 +1776,71 @@ printk("### ----------------------------###\n");
 	}
 
 	ax_tx_timestamp(axdev);
+	spin_unlock_irqrestore(&ptp_cfg->ts_lock, flags);
 out:
-	ax88279_submit_ts(axdev);
+	if (ax88279_submit_ts(axdev, ep4, GFP_ATOMIC) < 0)
+		return;
+
+	gap = ktime_get_ns() - start;
+	axdev->ptp_ep4_gap_last = gap;
+	if (gap > axdev->ptp_ep4_gap_max)
+		axdev->ptp_ep4_gap_max = gap;
 }
 
-static int ax88279_submit_ts(struct ax_device *axdev)
+static int ax88279_submit_ts(struct ax_device *axdev,
+			     struct ax_ptp_ep4 *ep4, gfp_t mem_flags)
 {
 	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
-	struct urb *urb = ptp_cfg->urb;
 	int ret;
 
 	if (test_bit(AX_UNPLUG, &axdev->flags) ||
 	    !test_bit(AX_ENABLE, &axdev->flags))
 		return 0;
 
-	memset(ptp_cfg->ep4_buf, 0, AX_PTP_EP4_SIZE);
+	memset(ep4->buf, 0, AX_PTP_EP4_SIZE);
 
-	usb_fill_bulk_urb(urb, axdev->udev,
+	usb_fill_bulk_urb(ep4->urb, axdev->udev,
 			   usb_rcvbulkpipe(axdev->udev, 4),
-			   (void *)ptp_cfg->ep4_buf, AX_PTP_EP4_SIZE,
-			   (usb_complete_t)ax88279_read_ts_callback, axdev);
-
-	ret = usb_submit_urb(urb, GFP_KERNEL);
-	if (ret == -ENODEV)
-		netif_device_detach(axdev->netdev);
-
-	urb->actual_length = 0;
+			   (void *)ep4->buf, AX_PTP_EP4_SIZE,
+			   (usb_complete_t)ax88279_read_ts_callback, ep4);
+
+	atomic_inc(&ptp_cfg->ep4_inflight);
+	ret = usb_submit_urb(ep4->urb, mem_flags);
+	if (ret < 0) {
+		atomic_dec(&ptp_cfg->ep4_inflight);
+		if (ret == -ENODEV)
+			netif_device_detach(axdev->netdev);
+	}
 
 	return ret;
 }
 
 int ax88279_start_get_ts(struct ax_device *axdev)
 {
-	int ret;
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	int i, ret = 0;
 
 	if (axdev->chip_version <= AX_VERSION_AX88179A_772D)
 		return 0;
 
-	ret = ax88279_submit_ts(axdev);
-	if (ret < 0)
-		dev_err(&axdev->intf->dev, "Failed to submit EP4 for TS\n");
+	if (!ptp_cfg)
+		return 0;
+
+	for (i = 0; i < AX_PTP_EP4_URBS; i++) {
+		if (!ptp_cfg->ep4[i].urb)
+			continue;
+
+		ret = ax88279_submit_ts(axdev, &ptp_cfg->ep4[i], GFP_KERNEL);
+		if (ret == -EBUSY) {
+			ret = 0;
+			continue;
+		}
+		if (ret < 0) {
+			dev_err(&axdev->intf->dev,
+				"Failed to submit EP4 for TS\n");
+			break;
+		}
+	}
 
 	return ret;
 }
@@ -1104,12 +1848,55 @@ int ax88279_start_get_ts(struct ax_device *axdev)
 void ax88279_stop_get_ts(struct ax_device *axdev)
 {
 	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	int i;
 
 	if (axdev->chip_version <= AX_VERSION_AX88179A_772D)
 		return;
 
-	if (ptp_cfg->urb)
-		usb_kill_urb(ptp_cfg->urb);
+	if (!ptp_cfg)
+		return;
+
+	for (i = 0; i < AX_PTP_EP4_URBS; i++) {
+		if (ptp_cfg->ep4[i].urb)
+			usb_kill_urb(ptp_cfg->ep4[i].urb);
+	}
+}
+
+static int ax88279_alloc_ts(struct ax_device *axdev)
+{
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	int i;
+
+	for (i = 0; i < AX_PTP_EP4_URBS; i++) {
+		struct ax_ptp_ep4 *ep4 = &ptp_cfg->ep4[i];
+
+		ep4->axdev = axdev;
+		ep4->buf = kmalloc(AX_PTP_EP4_SIZE, GFP_KERNEL);
+		if (!ep4->buf)
+			return -ENOMEM;
+
+		ep4->urb = usb_alloc_urb(0, GFP_KERNEL);
+		if (!ep4->urb)
+			return -ENOMEM;
+	}
+
+	atomic_set(&ptp_cfg->ep4_inflight, 0);
+	spin_lock_init(&ptp_cfg->ts_lock);
+
+	return 0;
+}
+
+static void ax88279_free_ts(struct ax_device *axdev)
+{
+	struct ax_ptp_cfg *ptp_cfg = axdev->ptp_cfg;
+	int i;
+
+	for (i = 0; i < AX_PTP_EP4_URBS; i++) {
+		usb_free_urb(ptp_cfg->ep4[i].urb);
+		ptp_cfg->ep4[i].urb = NULL;
+		kfree(ptp_cfg->ep4[i].buf);
+		ptp_cfg->ep4[i].buf = NULL;
+	}
 }
 #endif
 
@@ -1122,12 +1909,20 @@ int ax_ptp_register(struct ax_device *axdev)
 	if (!ptp_cfg)
 		return -ENOMEM;
 	axdev->ptp_cfg = ptp_cfg;
+	ptp_cfg->rx_filter = HWTSTAMP_FILTER_PTP_V2_EVENT;
+	ptp_cfg->tx_type = HWTSTAMP_TX_OFF;
+	ptp_cfg->pps_enable = 1;
+	ptp_cfg->pps_width = AX_PPS_ACTIVE_DEFAULT_TIME;
+	memset(ptp_cfg->cal_tx_delay, 0xFF, sizeof(ptp_cfg->cal_tx_delay));
+	memset(ptp_cfg->cal_rx_delay, 0xFF, sizeof(ptp_cfg->cal_rx_delay));
+	init_completion(&ptp_cfg->cal_tx_done);
+	init_completion(&ptp_cfg->cal_rx_done);
 
 	switch (axdev->chip_version) {
 #ifdef ENABLE_AX88279
 	case AX_VERSION_AX88279:
-		ptp_cfg->urb = usb_alloc_urb(0, GFP_KERNEL);
-		if (!ptp_cfg->urb)
+		ret = ax88279_alloc_ts(axdev);
+		if (ret < 0)
 			goto fail;
 
 		ptp_cfg->ptp_caps = ax88279_ptp_clock;
@@ -1142,6 +1937,15 @@ int ax_ptp_register(struct ax_device *axdev)
 		return 0;
 	};
 
+	snprintf(ptp_cfg->pin_config[AX_PTP_PIN_PPS_OUT].name,
+		 sizeof(ptp_cfg->pin_config[AX_PTP_PIN_PPS_OUT].name),
+		 "PPS_OUT");
+	ptp_cfg->pin_config[AX_PTP_PIN_PPS_OUT].index = AX_PTP_PIN_PPS_OUT;
+	ptp_cfg->pin_config[AX_PTP_PIN_PPS_OUT].func = PTP_PF_PEROUT;
+	ptp_cfg->pin_config[AX_PTP_PIN_PPS_OUT].chan = 0;
+	ptp_cfg->ptp_caps.pin_config = ptp_cfg->pin_config;
+	ptp_cfg->axdev = axdev;
+
 	ptp_cfg->ptp_clock = ptp_clock_register(&ptp_cfg->ptp_caps,
 						&axdev->udev->dev);
 	if (IS_ERR(ptp_cfg->ptp_clock)) {
@@ -1153,15 +1957,13 @@ int ax_ptp_register(struct ax_device *axdev)
 	ptp_cfg->phc_index = ptp_clock_index(ptp_cfg->ptp_clock);
 	skb_queue_head_init(&axdev->tx_timestamp);
 
-	ptp_cfg->axdev = axdev;
-
 	return 0;
 fail:
 #ifdef ENABLE_AX88279
-	if (ptp_cfg->urb)
-		usb_free_urb(axdev->intr_urb);
+	ax88279_free_ts(axdev);
 #endif
 	kfree(axdev->ptp_cfg);
+	axdev->ptp_cfg = NULL;
 
 	return ret;
 }
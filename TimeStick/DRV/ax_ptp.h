@@ -48,19 +48,27 @@
 	#define AX_EXT_INT_ON		0x10
 	#define AX_PTP_TX_TX_INT_EN	0x40
 
-// Ethernet: 14B, IPv4: 20B, UDP: 8B
-#define AX_TX_PTPHDR_OFFSET_L3_IP	42
-// Ethernet: 14B, IPv6: 40B, UDP: 8B
-#define AX_TX_PTPHDR_OFFSET_L3_IPV6	62
-// Ethernet: 14B
-#define AX_TX_PTPHDR_OFFSET_L2	14
 #define AX_ETHTYPE_OFFSET		12
 #define AX_IP_PROTO_OFFSET		9
 #define AX_UDP_PORT_OFFSET		22
 #define AX_PTP_EVENT_PORT_NUM		0x13F
 #define PTP_HDR_SIZE			34
+#define AX_PTP_VERSION_2		0x02
+#define AX_PTP_FLAG_TWO_STEP		0x0200
 
 #define AX_PPS_ACTIVE_DEFAULT_TIME	0x1DCD6500
+#define AX_PTP_PEROUT_PERIOD		NSEC_PER_SEC
+#define AX_PTP_N_PEROUT			1
+#define AX_PTP_PIN_PPS_OUT		0
+#define AX_PTP_N_PINS			1
+
+#define AX_PTP_DELAY_SPEEDS		4	/* 10/100/1000/2500M */
+#define AX_PTP_CAL_SEQ_ID		0xCA1B
+#define AX_PTP_CAL_FRAME_LEN		ETH_ZLEN
+#define AX_PTP_CAL_SETTLE_MS		20
+#define AX_PTP_CAL_TIMEOUT_MS		200
+#define AX_PTP_CAL_MAX_DELTA		100000	/* ns */
+#define AX_PTP_TX_TS_TIMEOUT_MS		1000
 #define AX_BASE_ADDEND			0xCCCCCCCC
 #define AX_PTP_PERIOD			0xA
 
@@ -133,6 +141,17 @@
 	AX_RXC0_PARSER_UDPV6_EN | AX_RXC0_PARSER_UDP_PTP_EN | \
 	AX_RXC0_PARSER_UDPV6_PTP_EN | AX_RXC0_PARSER_EVENT_PORT_EN)
 
+#define AX_PTP_RX_CTRL0_L2	\
+	(AX_PTP_RXC0_EN | AX_RXC0_PARSER_L2_EN | AX_RXC0_PARSER_L2_PTP_EN | \
+	AX_RXC0_PARSER_VLAN_EN)
+
+#define AX_PTP_RX_CTRL0_L4	\
+	(AX_PTP_RXC0_EN | AX_RXC0_PARSER_L2_EN | \
+	AX_RXC0_PARSER_IPV4_EN | AX_RXC0_PARSER_IPV6_EN | \
+	AX_RXC0_PARSER_VLAN_EN | AX_RXC0_PARSER_UDP_EN | \
+	AX_RXC0_PARSER_UDPV6_EN | AX_RXC0_PARSER_UDP_PTP_EN | \
+	AX_RXC0_PARSER_UDPV6_PTP_EN | AX_RXC0_PARSER_EVENT_PORT_EN)
+
 #define AX_PTP_TX_CTRL0			0x3000
 	#define AX_PTP_TXC0_EN			0x0001
 	#define AX_PTP_TXC0_XGMII_EN		0x0002
@@ -177,6 +196,15 @@ struct _ptp_header {
 	u8	log_msg_interval;
 } __packed;
 
+/* PTP fields of a TX frame, parsed once in tx_fixup and kept in skb->cb */
+struct ax_ptp_skb_cb {
+	unsigned long	queued;
+	u16	sequence_id;
+	u16	flags;
+	u8	msg_type;
+};
+#define AX_PTP_SKB_CB(skb)	((struct ax_ptp_skb_cb *)(skb)->cb)
+
 struct _179a_ptp_info {
 	u8	reserved	:3,
 		status		:1,
@@ -207,20 +235,49 @@ struct _ax_ptp_usb_info {
 	void *axdev;
 };
 
+#ifdef ENABLE_AX88279
+#define AX_PTP_EP4_SIZE	((2 * AX_PTP_INFO_SIZE * AX_PTP_HW_QUEUE_SIZE) + 1)
+#define AX_TS_SEG_1		1
+#define AX_PTP_EP4_URBS		4
+
+struct ax_ptp_ep4 {
+	struct urb *urb;
+	unsigned char *buf;
+	struct ax_device *axdev;
+};
+#endif
+
 struct ax_ptp_cfg {
 	void *axdev;
 	struct ptp_clock_info ptp_caps;
 	struct ptp_clock *ptp_clock;
+	struct ptp_pin_desc pin_config[AX_PTP_N_PINS];
 	unsigned int phc_index;
 	struct _ax_ptp_info tx_ptp_info[AX_PTP_QUEUE_SIZE];
 	unsigned long ptp_head, ptp_tail, num_items;
 	int get_timestamp_retry;
+	u32 addend;
+	int rx_filter;
+	int tx_type;
+	u32 pps_width;
+	u8 pps_enable;
+	u8 ptp_ctrl1;
+	u8 hw_ready;
+#define AX_PTP_PM_HOLD	0
+	unsigned long pm_hold;
+	u64 resume_ns;
+	s32 cal_tx_delay[AX_PTP_DELAY_SPEEDS];
+	s32 cal_rx_delay[AX_PTP_DELAY_SPEEDS];
+	struct sk_buff *cal_skb;
+	u64 cal_tx_ts;
+	u64 cal_rx_ts;
+	struct completion cal_tx_done;
+	struct completion cal_rx_done;
 #ifdef ENABLE_AX88279
-#define AX_PTP_EP4_SIZE	((2 * AX_PTP_INFO_SIZE * AX_PTP_HW_QUEUE_SIZE) + 1)
-#define AX_TS_SEG_1		1
 #define AX_EP4_INFO_SIZE (AX_PTP_QUEUE_SIZE * AX_PTP_EP4_SIZE)
-	struct urb *urb;
-	unsigned char ep4_buf[AX_PTP_EP4_SIZE];
+	struct ax_ptp_ep4 ep4[AX_PTP_EP4_URBS];
+	atomic_t ep4_inflight;
+	spinlock_t ts_lock;
 	struct _ax_ptp_info ep4_ptp_info[AX_EP4_INFO_SIZE];
 #endif
 };
@@ -238,5 +295,11 @@ int ax88279_start_get_ts(struct ax_device *axdev);
 void ax88279_stop_get_ts(struct ax_device *axdev);
 #endif
 int ax_ptp_ts_read_cmd_async(struct ax_device *axdev);
+void ax_ptp_pm_update(struct ax_device *axdev);
+bool ax_ptp_tx_parse(struct sk_buff *skb);
 void ax_rx_get_timestamp(struct sk_buff *skb, u64 *pkt_hdr);
+int ax_ptp_set_rx_filter(struct ax_device *axdev, int rx_filter);
+int ax_ptp_delay_calibrate(struct ax_device *axdev, s32 *tx_delay,
+			   s32 *rx_delay);
+void ax_ptp_cal_rx(struct ax_device *axdev, struct sk_buff *skb);
 #endif /* End of __ASIX_PTP_H */